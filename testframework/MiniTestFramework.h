@@ -2,10 +2,17 @@
 #define IMG_MiniTestFramework_h_
 
 #include "TestHelpers.h"
+#include "allocations.h"
 #include "assertions.h"
+#include "benchmark.h"
+#include "generators.h"
 #include "testfailure.h"
 
+#include <cstdint>
+#include <iterator>
 #include <memory>
+#include <mutex>
+#include <type_traits>
 #include <utility>
 #include <vector>
 
@@ -25,35 +32,179 @@ namespace UnitTests
     };
 
     class Reporter;
+    struct RunOptions;
 
     class MiniSuite
     {
     public:
         static MiniSuite& Instance();
 
+        // A registered test, the suite walks a list of these. TEST and TEST_T define them as statics with a constexpr
+        // constructor and link them in as the program starts, so registering those tests allocates nothing.
+        class Node
+        {
+        public:
+            using run_function   = void (*)(const Node& node, int index);
+            using count_function = int (*)(const Node& node);
+
+            // a test that calls fn()
+            constexpr Node(const char* suite, const char* name, const char* file, int line, void (*fn)())
+                : m_suite(suite), m_name(name), m_file(file), m_line(line), m_run(&run_function_test),
+                  m_count(&count_one), m_data(nullptr), m_fn(fn)
+            {
+            }
+
+            // a test with `count(*this)` indexes, run with `run(*this, index)`
+            constexpr Node(const char* suite, const char* name, const char* file, int line, run_function run,
+                count_function count, const void* data)
+                : m_suite(suite), m_name(name), m_file(file), m_line(line), m_run(run), m_count(count), m_data(data),
+                  m_fn(nullptr)
+            {
+            }
+
+            Node(const Node&) = delete;
+            Node& operator=(const Node&) = delete;
+
+            void Run(int index) const
+            {
+                m_run(*this, index);
+            }
+
+            int NumTests() const
+            {
+                return m_count(*this);
+            }
+
+            std::string BareName(const std::string& indexs) const;
+
+            std::string Name(const std::string& indexs) const;
+
+            // the test's name without any param index
+            const char* BareName() const
+            {
+                return m_name;
+            }
+
+            const char* Suite() const
+            {
+                return m_suite;
+            }
+
+            const char* File() const
+            {
+                return m_file;
+            }
+
+            int Line() const
+            {
+                return m_line;
+            }
+
+            const void* Data() const
+            {
+                return m_data;
+            }
+
+            const Node* Next() const
+            {
+                return m_next;
+            }
+
+            static int count_one(const Node& /*unused*/)
+            {
+                return 1;
+            }
+
+            // runs a default constructed Function, as used for TEST_T
+            template <class Function>
+            static void run_functor(const Node& /*unused*/, int /*unused*/)
+            {
+                Function()();
+            }
+
+        private:
+            friend class MiniSuite;
+
+            static void run_function_test(const Node& node, int /*unused*/)
+            {
+                node.m_fn();
+            }
+
+            const char*    m_suite;
+            const char*    m_name;
+            const char*    m_file;
+            int            m_line;
+            run_function   m_run;
+            count_function m_count;
+            const void*    m_data;
+            void (*m_fn)();
+            Node* m_next = nullptr;
+        };
+
+        // A test added at run time, it owns its suite and name and is run through a virtual call.
         class Test
         {
         public:
             Test(std::string suite, std::string name, const char* file, int line)
-                : m_suite(std::move(suite)), m_name(std::move(name)), m_file(file), m_line(line)
+                : m_suite(std::move(suite)), m_name(std::move(name)),
+                  m_node(m_suite.c_str(), m_name.c_str(), file, line, &run_test, &count_tests, this)
             {
             }
 
+            Test(const Test&) = delete;
+            Test& operator=(const Test&) = delete;
+
             virtual void Run(int) const   = 0;
             virtual int  NumTests() const = 0;
             virtual ~Test()               = default;
 
-            std::string BareName(const std::string& indexs) const;
+            std::string BareName(const std::string& indexs) const
+            {
+                return m_node.BareName(indexs);
+            }
 
-            std::string Name(const std::string& indexs) const;
+            std::string Name(const std::string& indexs) const
+            {
+                return m_node.Name(indexs);
+            }
 
-            std::string Suite() const;
+            // the test's name without any param index
+            const std::string& BareName() const
+            {
+                return m_name;
+            }
+
+            const std::string& Suite() const
+            {
+                return m_suite;
+            }
+
+            const char* File() const
+            {
+                return m_node.File();
+            }
+
+            int Line() const
+            {
+                return m_node.Line();
+            }
 
         private:
+            friend class MiniSuite;
+
+            static void run_test(const Node& node, int index)
+            {
+                static_cast<const Test*>(node.Data())->Run(index);
+            }
+
+            static int count_tests(const Node& node)
+            {
+                return static_cast<const Test*>(node.Data())->NumTests();
+            }
+
             std::string m_suite;
             std::string m_name;
-            const char* m_file;
-            int         m_line;
+            Node        m_node;
         };
 
         template <class Function>
@@ -79,6 +230,8 @@ namespace UnitTests
             Function m_fn;
         };
 
+        // Random access containers are indexed directly, for any other container the iterator for each index is found
+        // in a single pass the first time it is needed, so a run is linear in the number of parameters.
         template <class Container, class Function>
         class ParamFunctionTest : public Test
         {
@@ -93,22 +246,115 @@ namespace UnitTests
 
             int NumTests() const override
             {
-                return static_cast<int>(std::distance(m_cont.begin(), m_cont.end()));
+                return num_tests(category{});
             }
 
             void Run(int index) const override
             {
-                auto arg = std::next(m_cont.begin(), index);
-                m_fn(*arg);
+                m_fn(*param(index, category{}));
+            }
+
+        private:
+            using iterator = decltype(std::declval<const Container&>().begin());
+            using category = typename std::iterator_traits<iterator>::iterator_category;
+
+            int num_tests(std::random_access_iterator_tag) const
+            {
+                return static_cast<int>(m_cont.end() - m_cont.begin());
+            }
+
+            int num_tests(std::input_iterator_tag) const
+            {
+                return static_cast<int>(iterators().size());
+            }
+
+            iterator param(int index, std::random_access_iterator_tag) const
+            {
+                return m_cont.begin() + index;
+            }
+
+            iterator param(int index, std::input_iterator_tag) const
+            {
+                return iterators()[static_cast<size_t>(index)];
+            }
+
+            const std::vector<iterator>& iterators() const
+            {
+                std::call_once(m_once, [this] {
+                    for (auto it = m_cont.begin(); it != m_cont.end(); ++it)
+                        m_iterators.push_back(it);
+                });
+                return m_iterators;
+            }
+
+            Container                     m_cont;
+            Function                      m_fn;
+            mutable std::once_flag        m_once;
+            mutable std::vector<iterator> m_iterators;
+        };
+
+        // A BENCHMARK, linked into its own list in the same way as a Node.
+        class Benchmark
+        {
+        public:
+            constexpr Benchmark(
+                const char* suite, const char* name, const char* file, int line, void (*fn)(BenchmarkState&))
+                : m_suite(suite), m_name(name), m_file(file), m_line(line), m_fn(fn)
+            {
+            }
+
+            Benchmark(const Benchmark&) = delete;
+            Benchmark& operator=(const Benchmark&) = delete;
+
+            void Run(BenchmarkState& state) const
+            {
+                m_fn(state);
+            }
+
+            const char* Name() const
+            {
+                return m_name;
+            }
+
+            const char* Suite() const
+            {
+                return m_suite;
+            }
+
+            const char* File() const
+            {
+                return m_file;
+            }
+
+            int Line() const
+            {
+                return m_line;
+            }
+
+            const Benchmark* Next() const
+            {
+                return m_next;
             }
 
         private:
-            Container m_cont;
-            Function  m_fn;
+            friend class MiniSuite;
+
+            const char* m_suite;
+            const char* m_name;
+            const char* m_file;
+            int         m_line;
+            void (*m_fn)(BenchmarkState&);
+            Benchmark* m_next = nullptr;
         };
 
         size_t AddTest(std::unique_ptr<Test> test);
 
+        // links a statically allocated test into the suite, `node` must outlive the suite
+        size_t AddTest(Node& node);
+
+        // links a statically allocated benchmark into the suite, `benchmark` must outlive the suite
+        size_t AddBenchmark(Benchmark& benchmark);
+
         template <class Function>
         size_t AddTest(Function fn, const char* suite, const char* name, const char* file, int line)
         {
@@ -116,22 +362,26 @@ namespace UnitTests
             return AddTest(std::move(test));
         }
 
+        // an array or container is copied into the test, pass a ParamView to use a static table in place
         template <class Container, class Function>
         size_t AddParamTest(
             const Container& cont, Function fn, const char* suite, const char* name, const char* file, int line)
         {
-            auto test = std::unique_ptr<Test>(
-                std::make_unique<ParamFunctionTest<Container, Function>>(cont, fn, suite, name, file, line));
+            using Params = decltype(detail::CopyParams(cont));
+            auto test    = std::unique_ptr<Test>(std::make_unique<ParamFunctionTest<Params, Function>>(
+                detail::CopyParams(cont), fn, suite, name, file, line));
             return AddTest(std::move(test));
         }
 
-        template <typename T, size_t N, class Function>
+        // a temporary container, or a ParamView, is moved into the test
+        template <class Container, class Function,
+            std::enable_if_t<!std::is_lvalue_reference<Container>::value, int> = 0>
         size_t AddParamTest(
-            const T (&data)[N], Function fn, const char* suite, const char* name, const char* file, int line)
+            Container&& cont, Function fn, const char* suite, const char* name, const char* file, int line)
         {
-            using std::begin;
-            using std::end;
-            return AddParamTest(std::vector<T>(begin(data), end(data)), fn, suite, name, file, line);
+            auto test = std::unique_ptr<Test>(std::make_unique<ParamFunctionTest<std::decay_t<Container>, Function>>(
+                std::move(cont), fn, suite, name, file, line));
+            return AddTest(std::move(test));
         }
 
         bool IsVerbose(const std::vector<std::string>& args);
@@ -142,76 +392,106 @@ namespace UnitTests
         int RunTests(const std::vector<std::string>& args, std::ostream& os);
 
     private:
+        Node*                              m_first           = nullptr;
+        Node*                              m_last            = nullptr;
+        Benchmark*                         m_first_benchmark = nullptr;
+        Benchmark*                         m_last_benchmark  = nullptr;
         std::vector<std::unique_ptr<Test>> tests;
 
-        int run_tests(std::vector<std::unique_ptr<Test>>& tests, Reporter& reporter);
+        int run_tests(const RunOptions& options, Reporter& reporter);
+        int run_benchmarks(const RunOptions& options, std::ostream& os);
     };
 
 #define _TEST1(name) _TEST(test_suite, name)
 
 #define _TEST2(suite, name) _TEST(#suite, name)
 
-#define _TEST(suite, name)                                                                        \
-    void name();                                                                                  \
-    namespace                                                                                     \
-    {                                                                                             \
-        namespace PP_CAT(unique, __LINE__)                                                        \
-        {                                                                                         \
-            const size_t ignore_this_warning =                                                    \
-                UnitTests::MiniSuite::Instance().AddTest(name, suite, #name, __FILE__, __LINE__); \
-        }                                                                                         \
-    }                                                                                             \
+#define _TEST(suite, name)                                                                     \
+    void name();                                                                               \
+    namespace                                                                                  \
+    {                                                                                          \
+        namespace PP_CAT(unique, __LINE__)                                                     \
+        {                                                                                      \
+            UnitTests::MiniSuite::Node node(suite, #name, __FILE__, __LINE__, name);           \
+            const size_t ignore_this_warning = UnitTests::MiniSuite::Instance().AddTest(node); \
+        }                                                                                      \
+    }                                                                                          \
     void name() /**/
 
-#define TEST_T(suite, name, list_of_types)                                                                         \
-    template <typename test_type>                                                                                  \
-    struct name                                                                                                    \
-    {                                                                                                              \
-        void operator()() const;                                                                                   \
-    };                                                                                                             \
-    namespace                                                                                                      \
-    {                                                                                                              \
-        namespace PP_CAT(unique, __LINE__)                                                                         \
-        {                                                                                                          \
-            template <typename... T>                                                                               \
-            struct expander;                                                                                       \
-                                                                                                                   \
-            template <typename T>                                                                                  \
-            struct expander<T>                                                                                     \
-            {                                                                                                      \
-                size_t operator()() const                                                                          \
-                {                                                                                                  \
-                    return UnitTests::MiniSuite::Instance().AddTest(name<T>(), #suite, #name, __FILE__, __LINE__); \
-                }                                                                                                  \
-            };                                                                                                     \
-                                                                                                                   \
-            template <typename T, typename... Args>                                                                \
-            struct expander<T, Args...>                                                                            \
-            {                                                                                                      \
-                isize_tnt operator()() const                                                                       \
-                {                                                                                                  \
-                    return expander<T>()(), expander<Args...>()();                                                 \
-                }                                                                                                  \
-            };                                                                                                     \
-                                                                                                                   \
-            template <typename... Args>                                                                            \
-            struct expander<UnitTests::typelist<Args...>>                                                          \
-            {                                                                                                      \
-                isize_tnt operator()() const                                                                       \
-                {                                                                                                  \
-                    return expander<Args...>()();                                                                  \
-                }                                                                                                  \
-            };                                                                                                     \
-            const size_t ignore_this_warning = expander<list_of_types>()();                                        \
-        }                                                                                                          \
-    }                                                                                                              \
-    template <typename test_type>                                                                                  \
+#define TEST_T(suite, name, list_of_types)                                                                      \
+    template <typename test_type>                                                                               \
+    struct name                                                                                                 \
+    {                                                                                                           \
+        void operator()() const;                                                                                \
+    };                                                                                                          \
+    namespace                                                                                                   \
+    {                                                                                                           \
+        namespace PP_CAT(unique, __LINE__)                                                                      \
+        {                                                                                                       \
+            template <typename... T>                                                                            \
+            struct expander;                                                                                    \
+                                                                                                                \
+            template <typename T>                                                                               \
+            struct expander<T>                                                                                  \
+            {                                                                                                   \
+                size_t operator()() const                                                                       \
+                {                                                                                               \
+                    static UnitTests::MiniSuite::Node node(#suite, #name, __FILE__, __LINE__,                   \
+                        &UnitTests::MiniSuite::Node::run_functor<name<T>>, &UnitTests::MiniSuite::Node::count_one, \
+                        nullptr);                                                                               \
+                    return UnitTests::MiniSuite::Instance().AddTest(node);                                      \
+                }                                                                                               \
+            };                                                                                                  \
+                                                                                                                \
+            template <typename T, typename... Args>                                                             \
+            struct expander<T, Args...>                                                                         \
+            {                                                                                                   \
+                size_t operator()() const                                                                       \
+                {                                                                                               \
+                    return expander<T>()(), expander<Args...>()();                                              \
+                }                                                                                               \
+            };                                                                                                  \
+                                                                                                                \
+            template <typename... Args>                                                                         \
+            struct expander<UnitTests::typelist<Args...>>                                                       \
+            {                                                                                                   \
+                size_t operator()() const                                                                       \
+                {                                                                                               \
+                    return expander<Args...>()();                                                               \
+                }                                                                                               \
+            };                                                                                                  \
+            const size_t ignore_this_warning = expander<list_of_types>()();                                     \
+        }                                                                                                       \
+    }                                                                                                           \
+    template <typename test_type>                                                                               \
     void name<test_type>::operator()() const /**/
 
+// BENCHMARK(name) or BENCHMARK(suite, name) times a loop over state.KeepRunning(), see benchmark.h. Benchmarks are only
+// run with --benchmark, which runs them instead of the tests.
+#define _BENCHMARK1(name) _BENCHMARK(test_suite, name)
+
+#define _BENCHMARK2(suite, name) _BENCHMARK(#suite, name)
+
+#define _BENCHMARK(suite, name)                                                                           \
+    void name(UnitTests::BenchmarkState& state);                                                          \
+    namespace                                                                                             \
+    {                                                                                                     \
+        namespace PP_CAT(unique, __LINE__)                                                                \
+        {                                                                                                 \
+            UnitTests::MiniSuite::Benchmark benchmark(suite, #name, __FILE__, __LINE__, name);            \
+            const size_t ignore_this_warning = UnitTests::MiniSuite::Instance().AddBenchmark(benchmark);  \
+        }                                                                                                 \
+    }                                                                                                     \
+    void name(UnitTests::BenchmarkState& state) /**/
+
 #define _PARAM_TEST2(name, data) _PARAM_TEST(test_suite, name, data)
 
 #define _PARAM_TEST3(suite, name, data) _PARAM_TEST(#suite, name, data)
 
+#define _PARAM_TEST_VIEW2(name, data) _PARAM_TEST(test_suite, name, UnitTests::MakeParamView(data))
+
+#define _PARAM_TEST_VIEW3(suite, name, data) _PARAM_TEST(#suite, name, UnitTests::MakeParamView(data))
+
 #define _PARAM_TEST(suite, name, data)                                                                         \
     struct name                                                                                                \
     {                                                                                                          \
@@ -276,10 +556,36 @@ namespace UnitTests
     template <typename T>                                                    \
     void name<test_type>::operator()(const T& args) const /**/
 
+// use TIMEOUT(ms) in a test to give it a time limit other than the one given by --timeout-ms, e.g.
+//
+//  TEST(slow_test)
+//  {
+//      TIMEOUT(5000);
+//      ...
+//  }
+//
+// A test that overruns is reported as a timeout at the TIMEOUT line, and the run stops waiting for it and moves on.
+#define TIMEOUT(ms) UnitTests::SetTimeout(ms, __FILE__, __LINE__)
+
+    void SetTimeout(int milliseconds, const char* file, int line);
+
+    // how PROPERTY_TEST cases are made, see property.h
+    struct PropertySettings
+    {
+        uint64_t seed  = 0;
+        int      cases = 1000;
+    };
+
+    // the settings of the run on this thread
+    const PropertySettings& CurrentPropertySettings();
+
 #define EXPAND(x) x
 #define GET_MACRO(_1, _2, _3, NAME, ...) NAME
 #define TEST(...) EXPAND(GET_MACRO(__VA_ARGS__, _TEST3, _TEST2, _TEST1, _UNUSED)(__VA_ARGS__))
+#define BENCHMARK(...) EXPAND(GET_MACRO(__VA_ARGS__, _UNUSED, _BENCHMARK2, _BENCHMARK1, _UNUSED)(__VA_ARGS__))
 #define PARAM_TEST(...) EXPAND(GET_MACRO(__VA_ARGS__, _PARAM_TEST3, _PARAM_TEST2, _UNUSED)(__VA_ARGS__))
+// PARAM_TEST copies its data, PARAM_TEST_VIEW uses a table with static storage in place, e.g. a large const array
+#define PARAM_TEST_VIEW(...) EXPAND(GET_MACRO(__VA_ARGS__, _PARAM_TEST_VIEW3, _PARAM_TEST_VIEW2, _UNUSED)(__VA_ARGS__))
 
 #define ADD_TESTS(name, data) UnitTests::MiniSuite::Instance().AddParamTest(data, name, #name, __FILE__, __LINE__);
 
@@ -306,9 +612,10 @@ namespace UnitTests
 
 } // namespace UnitTests
 
-static const char* test_suite = "anonymous";
+// a constant, so TEST nodes using the default suite are constant initialised
+static constexpr const char* test_suite = "anonymous";
 
-#ifdef TEST_MAIN
+#if defined(TEST_MAIN) || defined(TEST_FUZZ_MAIN)
 #include "testmain.inl"
 #endif
 
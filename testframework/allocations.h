@@ -0,0 +1,70 @@
+#if !defined(TestFramework_allocations_h_)
+#define TestFramework_allocations_h_
+#include "assertions.h"
+#include "testfailure.h"
+
+#include <cstdint>
+#include <sstream>
+#include <string>
+
+// use ASSERT_MAX_ALLOCATIONS to check code makes no more than n heap allocations, e.g. to keep a hot path free of them
+//
+//  TEST(lookup_does_not_allocate)
+//  {
+//      auto table = make_table();
+//      ASSERT_MAX_ALLOCATIONS(0, table.find(42));
+//  }
+//
+// Only the allocations made on the calling thread are counted. testmain.inl replaces the global operator new and
+// delete to count them when TEST_ALLOCATION_HOOKS is defined along with TEST_MAIN, without it a test using
+// ASSERT_MAX_ALLOCATIONS is skipped.
+#define ASSERT_MAX_ALLOCATIONS(n, ...)                                                                          \
+    do                                                                                                          \
+    {                                                                                                           \
+        const auto allocations_before_ = UnitTests::ThreadAllocations();                                        \
+        __VA_ARGS__;                                                                                            \
+        UnitTests::CheckMaxAllocations(                                                                         \
+            __FILE__, __LINE__, #__VA_ARGS__, n, UnitTests::ThreadAllocations() - allocations_before_);         \
+    } while (0) /**/
+
+namespace UnitTests
+{
+    // The heap allocations made through operator new.
+    struct AllocationCounts
+    {
+        uint64_t allocations   = 0;
+        uint64_t bytes         = 0;
+        uint64_t deallocations = 0;
+    };
+
+    inline AllocationCounts operator-(const AllocationCounts& after, const AllocationCounts& before)
+    {
+        auto counts          = AllocationCounts{};
+        counts.allocations   = after.allocations - before.allocations;
+        counts.bytes         = after.bytes - before.bytes;
+        counts.deallocations = after.deallocations - before.deallocations;
+        return counts;
+    }
+
+    // the allocations made on the calling thread since it started, all zero without the hooks
+    AllocationCounts ThreadAllocations();
+
+    bool AllocationHooksInstalled();
+
+    inline void CheckMaxAllocations(
+        const char* file, int line, const char* code, uint64_t max, const AllocationCounts& made)
+    {
+        if (!AllocationHooksInstalled())
+            throw TestSkipped();
+
+        if (made.allocations > max)
+        {
+            auto s = std::ostringstream{};
+            s << "Expected at most " << max << " allocations from " << code << " but it made " << made.allocations
+              << " (" << made.bytes << " bytes)";
+            Assert(file, line).Fail(s.str());
+        }
+    }
+} // namespace UnitTests
+
+#endif
@@ -8,25 +8,41 @@
 #include <functional>
 #include <iterator>
 #include <sstream>
+#include <string>
 #include <vector>
 
 using std::begin;
 using std::end;
 
+// the Assert behind each macro below, the __FILE__ it is given is kept by its failures as a pointer
+#define UNITTESTS_ASSERT(severity) \
+    UnitTests::Assert(UnitTests::MacroFile{__FILE__}, __LINE__, UnitTests::Assert::severity) /**/
+
 // use these macros to define your test conditions (they do as they say on the tin) :
 
-#define ASSERT_EQUALS UnitTests::Assert(__FILE__, __LINE__).Equals
-#define ASSERT_NOT_EQUALS UnitTests::Assert(__FILE__, __LINE__).NotEquals
-#define ASSERT_TRUE UnitTests::Assert(__FILE__, __LINE__).True
-#define ASSERT_FALSE UnitTests::Assert(__FILE__, __LINE__).False
-#define ASSERT_IN UnitTests::Assert(__FILE__, __LINE__).In
-#define ASSERT_NOT_IN UnitTests::Assert(__FILE__, __LINE__).NotIn
-#define FAIL UnitTests::Assert(__FILE__, __LINE__).Fail
-#define ASSERT_RANGE_EQUALS UnitTests::Assert(__FILE__, __LINE__).RangeEquals
+#define ASSERT_EQUALS UNITTESTS_ASSERT(Fatal).Equals
+#define ASSERT_NOT_EQUALS UNITTESTS_ASSERT(Fatal).NotEquals
+#define ASSERT_TRUE UNITTESTS_ASSERT(Fatal).True
+#define ASSERT_FALSE UNITTESTS_ASSERT(Fatal).False
+#define ASSERT_IN UNITTESTS_ASSERT(Fatal).In
+#define ASSERT_NOT_IN UNITTESTS_ASSERT(Fatal).NotIn
+#define FAIL UNITTESTS_ASSERT(Fatal).Fail
+#define ASSERT_RANGE_EQUALS UNITTESTS_ASSERT(Fatal).RangeEquals
 
 // Note this isn't a very good implementation of this because it ignores trailing whitespace on newlines, but it is a
 // start. compare multiline strings making it easier to spot differences when they are different
-#define ASSERT_MULTI_LINE_EQUALS UnitTests::Assert(__FILE__, __LINE__).MultiLineEquals
+#define ASSERT_MULTI_LINE_EQUALS UNITTESTS_ASSERT(Fatal).MultiLineEquals
+
+// EXPECT_* check what the ASSERT_* of the same name do, but a failure is recorded and the test carries on, so one run
+// shows every check that fails. The test fails when it returns, with the messages of all of them.
+#define EXPECT_EQUALS UNITTESTS_ASSERT(NonFatal).Equals
+#define EXPECT_NOT_EQUALS UNITTESTS_ASSERT(NonFatal).NotEquals
+#define EXPECT_TRUE UNITTESTS_ASSERT(NonFatal).True
+#define EXPECT_FALSE UNITTESTS_ASSERT(NonFatal).False
+#define EXPECT_IN UNITTESTS_ASSERT(NonFatal).In
+#define EXPECT_NOT_IN UNITTESTS_ASSERT(NonFatal).NotIn
+#define EXPECT_RANGE_EQUALS UNITTESTS_ASSERT(NonFatal).RangeEquals
+#define EXPECT_MULTI_LINE_EQUALS UNITTESTS_ASSERT(NonFatal).MultiLineEquals
 
 // use ASSERT_THROWS and ASSERT_THROWS_MSG to assert that code should test that code
 // e.g.
@@ -104,7 +120,7 @@ using std::end;
     }                                                          \
     catch (...)                                                \
     {                                                          \
-        throw UnitTests::TestFailure(msg, __FILE__, __LINE__); \
+        throw UnitTests::TestFailure(msg, UnitTests::MacroFile{__FILE__}, __LINE__); \
     }                                                          \
     /**/
 
@@ -150,10 +166,57 @@ namespace UnitTests
         }
     }
 
+    // the failures of the EXPECT_* checks made on this thread, the runner takes them when each test ends
+    std::vector<TestFailure>& RecordedFailures();
+
+    // Puts the failures already recorded on this thread aside while it lives, so the ones recorded meanwhile (e.g. by
+    // a test run from within another, or by one case of a PROPERTY_TEST) can be taken on their own.
+    class RecordingScope
+    {
+    public:
+        RecordingScope() : m_outer(std::move(RecordedFailures()))
+        {
+            RecordedFailures().clear();
+        }
+
+        RecordingScope(const RecordingScope&)            = delete;
+        RecordingScope& operator=(const RecordingScope&) = delete;
+
+        ~RecordingScope()
+        {
+            RecordedFailures() = std::move(m_outer);
+        }
+
+        std::vector<TestFailure> take()
+        {
+            auto failures = std::move(RecordedFailures());
+            RecordedFailures().clear();
+            return failures;
+        }
+
+    private:
+        std::vector<TestFailure> m_outer;
+    };
+
     class Assert
     {
     public:
-        Assert(const char* file, int line) : m_file(file), m_line(line)
+        // a Fatal failure throws TestFailure, a NonFatal one is added to RecordedFailures() and the check returns
+        enum Severity
+        {
+            Fatal,
+            NonFatal
+        };
+
+        // the file name is copied, so it can be made at run time
+        Assert(std::string file, int line, Severity severity = Fatal)
+            : m_file_copy(std::move(file)), m_line(line), m_severity(severity)
+        {
+        }
+
+        // used by the macros, the failures keep a pointer to their __FILE__
+        Assert(MacroFile file, int line, Severity severity = Fatal)
+            : m_file(file.name), m_line(line), m_severity(severity)
         {
         }
 
@@ -224,7 +287,7 @@ namespace UnitTests
             }
         }
 
-        [[noreturn]] void CreateInError(const char* msg, const std::string& needle, const std::string& haystack) const {
+        void CreateInError(const char* msg, const std::string& needle, const std::string& haystack) const {
             auto s = std::stringstream{};
             s << msg << needle << "\" in string \"" << haystack << " ";
             Error(s.str());
@@ -317,7 +380,7 @@ namespace UnitTests
 
         [[noreturn]] void Fail() const { Fail("Test FAIL'ed"); };
 
-        [[noreturn]] void Fail(const std::string& msg) const { Error(msg); }
+        [[noreturn]] void Fail(std::string msg) const { throw Failure(std::move(msg)); }
 
         void LargeStringEquals(const std::string& msg, const std::string& expected, const std::string& actual);
 
@@ -336,6 +399,7 @@ namespace UnitTests
             {
                 RangeError(msg, " length", expected_first, expected_last, got_first, got_last, expected_last,
                     expected_len, got_len);
+                return;
             }
 
             auto dif = std::mismatch(expected_first, expected_last, got_first).first;
@@ -452,7 +516,20 @@ namespace UnitTests
         };
 
     private:
-        [[noreturn]] void Error(const std::string& msg) const { throw TestFailure(msg, m_file, m_line); }
+        void Error(std::string msg) const
+        {
+            if (m_severity == NonFatal)
+                RecordedFailures().push_back(Failure(std::move(msg)));
+            else
+                throw Failure(std::move(msg));
+        }
+
+        TestFailure Failure(std::string msg) const
+        {
+            if (m_file)
+                return TestFailure(std::move(msg), MacroFile{m_file}, m_line);
+            return TestFailure(std::move(msg), m_file_copy, m_line);
+        }
 
         inline std::vector<std::string> split(const std::string& s, const char* delims = " \t\r\n\v")
         {
@@ -473,7 +550,7 @@ namespace UnitTests
         }
 
         template <typename Value, typename ContainerIterator>
-        [[noreturn]] void ContainmentError(const std::string& msg, const std::string& msg2, Value value,
+        void ContainmentError(const std::string& msg, const std::string& msg2, Value value,
             ContainerIterator begin, ContainerIterator end) const {
             auto s = std::ostringstream{};
             if (!msg.empty())
@@ -488,7 +565,7 @@ namespace UnitTests
         }
 
         template <class ExpectedIt, class GotIterator>
-        [[noreturn]] void RangeError(const std::string& msg, const std::string& reason, ExpectedIt expected_first,
+        void RangeError(const std::string& msg, const std::string& reason, ExpectedIt expected_first,
             ExpectedIt expected_last, GotIterator got_first, GotIterator got_last, ExpectedIt indicate,
             ptrdiff_t expected_len, ptrdiff_t got_len) const {
             auto s = std::ostringstream{};
@@ -502,8 +579,10 @@ namespace UnitTests
             Error(s.str());
         }
 
-        const char* m_file;
-        int m_line;
+        const char* m_file = nullptr;
+        std::string m_file_copy;
+        int         m_line;
+        Severity    m_severity;
     };
 } // namespace UnitTests
 
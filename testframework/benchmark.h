@@ -0,0 +1,125 @@
+#if !defined(TestFramework_benchmark_h_)
+#define TestFramework_benchmark_h_
+#include <chrono>
+#include <cstdint>
+
+#if defined(_MSC_VER) && !defined(__clang__)
+#include <intrin.h>
+#endif
+
+namespace UnitTests
+{
+    // Told when the loop of a benchmark starts and stops, so the runner can measure just the loop.
+    class BenchmarkListener
+    {
+    public:
+        virtual void loop_started() = 0;
+
+        virtual void loop_stopped() = 0;
+
+    protected:
+        ~BenchmarkListener() = default;
+    };
+
+    // Passed to a BENCHMARK, which times a loop of its own e.g. :
+    //               BENCHMARK(sort_1000)
+    //               {
+    //                  auto data = random_numbers(1000);
+    //                  while (state.KeepRunning())
+    //                  {
+    //                      auto copy = data;
+    //                      std::sort(begin(copy), end(copy));
+    //                      UnitTests::DoNotOptimize(copy);
+    //                  }
+    //               }
+    //
+    // Only the loop is timed, the runner picks the number of iterations.
+    class BenchmarkState
+    {
+    public:
+        using clock = std::chrono::steady_clock;
+
+        explicit BenchmarkState(int64_t iterations, BenchmarkListener* listener = nullptr)
+            : m_iterations(iterations), m_remaining(iterations), m_listener(listener)
+        {
+        }
+
+        bool KeepRunning()
+        {
+            if (m_remaining == m_iterations)
+            {
+                if (m_listener)
+                    m_listener->loop_started();
+                m_start = clock::now();
+            }
+            if (m_remaining == 0)
+            {
+                m_end = clock::now();
+                if (m_listener)
+                    m_listener->loop_stopped();
+                return false;
+            }
+            --m_remaining;
+            return true;
+        }
+
+        int64_t iterations() const
+        {
+            return m_iterations;
+        }
+
+        // false if the benchmark left the loop early, or never ran it
+        bool finished() const
+        {
+            return m_remaining == 0 && m_end != clock::time_point{};
+        }
+
+        clock::duration elapsed() const
+        {
+            return m_end - m_start;
+        }
+
+    private:
+        int64_t            m_iterations;
+        int64_t            m_remaining;
+        BenchmarkListener* m_listener;
+        clock::time_point  m_start;
+        clock::time_point  m_end;
+    };
+
+    // DoNotOptimize(value) makes the compiler believe value is read and may be written, so the code computing it can
+    // not be optimised away. ClobberMemory() makes it believe all memory is read and written, so pending stores are
+    // done.
+#if defined(_MSC_VER) && !defined(__clang__)
+    template <class T>
+    inline void DoNotOptimize(const T& value)
+    {
+        static_cast<void>(*static_cast<const volatile char*>(static_cast<const volatile void*>(&value)));
+        _ReadWriteBarrier();
+    }
+
+    inline void ClobberMemory()
+    {
+        _ReadWriteBarrier();
+    }
+#else
+    template <class T>
+    inline void DoNotOptimize(const T& value)
+    {
+        asm volatile("" : : "r,m"(value) : "memory");
+    }
+
+    template <class T>
+    inline void DoNotOptimize(T& value)
+    {
+        asm volatile("" : "+m"(value) : : "memory");
+    }
+
+    inline void ClobberMemory()
+    {
+        asm volatile("" : : : "memory");
+    }
+#endif
+} // namespace UnitTests
+
+#endif
@@ -0,0 +1,106 @@
+#if !defined(TestFramework_escape_h_)
+#define TestFramework_escape_h_
+#include <ostream>
+#include <string>
+
+namespace UnitTests
+{
+    // Text made safe to put in an XML document, for an attribute value the whitespace is kept by character references
+    // too. Control characters XML 1.0 can not hold at all become '?'.
+    class XmlEscaped
+    {
+    public:
+        explicit XmlEscaped(const std::string& text, bool attribute = false) : m_text(text), m_attribute(attribute)
+        {
+        }
+
+        friend std::ostream& operator<<(std::ostream& s, const XmlEscaped& escaped)
+        {
+            for (auto c : escaped.m_text)
+            {
+                switch (c)
+                {
+                    case '&':
+                        s << "&amp;";
+                        break;
+                    case '<':
+                        s << "&lt;";
+                        break;
+                    case '>':
+                        s << "&gt;";
+                        break;
+                    case '"':
+                        s << "&quot;";
+                        break;
+                    case '\'':
+                        s << "&apos;";
+                        break;
+                    case '\t':
+                    case '\n':
+                    case '\r':
+                        if (escaped.m_attribute)
+                            s << "&#" << static_cast<int>(c) << ';';
+                        else
+                            s << c;
+                        break;
+                    default:
+                        s << (static_cast<unsigned char>(c) < 0x20 ? '?' : c);
+                        break;
+                }
+            }
+            return s;
+        }
+
+    private:
+        const std::string& m_text;
+        bool               m_attribute;
+    };
+
+    // Text made safe to put between the quotes of a JSON string, anything that is not ASCII is passed on as it is so
+    // it should be UTF-8.
+    class JsonEscaped
+    {
+    public:
+        explicit JsonEscaped(const std::string& text) : m_text(text)
+        {
+        }
+
+        friend std::ostream& operator<<(std::ostream& s, const JsonEscaped& escaped)
+        {
+            static const char hex[] = "0123456789abcdef";
+            for (auto c : escaped.m_text)
+            {
+                switch (c)
+                {
+                    case '"':
+                        s << "\\\"";
+                        break;
+                    case '\\':
+                        s << "\\\\";
+                        break;
+                    case '\n':
+                        s << "\\n";
+                        break;
+                    case '\r':
+                        s << "\\r";
+                        break;
+                    case '\t':
+                        s << "\\t";
+                        break;
+                    default:
+                        if (static_cast<unsigned char>(c) < 0x20)
+                            s << "\\u00" << hex[(c >> 4) & 0xf] << hex[c & 0xf];
+                        else
+                            s << c;
+                        break;
+                }
+            }
+            return s;
+        }
+
+    private:
+        const std::string& m_text;
+    };
+} // namespace UnitTests
+
+#endif
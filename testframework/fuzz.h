@@ -0,0 +1,221 @@
+#if !defined(TestFramework_fuzz_h_)
+#define TestFramework_fuzz_h_
+#include "property.h"
+
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace UnitTests
+{
+    // use FUZZ_TEST in the same way as PROPERTY_TEST, e.g. :
+    //               FUZZ_TEST(parses_anything, std::string)
+    //               {
+    //                  parse(std::get<0>(args));
+    //               }
+    //
+    // In the test executable it is a PROPERTY_TEST, run on the cases made from --seed. Built with fuzzmain.inl (define
+    // TEST_FUZZ_MAIN rather than TEST_MAIN) it is also a libFuzzer target, the bytes of each input are decoded into
+    // args by Decode. With more than one FUZZ_TEST the FUZZ_TEST environment variable names the one to fuzz, otherwise
+    // the first byte of the input picks one.
+    //
+    // Specialise Decode and Arbitrary for your own types.
+
+    // The bytes of a fuzz input, read from the front. Once they run out everything decodes as zero or empty.
+    class FuzzInput
+    {
+    public:
+        FuzzInput(const uint8_t* data, size_t size) : m_data(data), m_size(size)
+        {
+        }
+
+        size_t remaining() const
+        {
+            return m_size;
+        }
+
+        uint8_t byte()
+        {
+            if (m_size == 0)
+                return 0;
+            --m_size;
+            return *m_data++;
+        }
+
+        // `size` bytes, padded with zeros if there are not enough left
+        void bytes(void* destination, size_t size)
+        {
+            auto n = size < m_size ? size : m_size;
+            std::memset(destination, 0, size);
+            if (n != 0)
+                std::memcpy(destination, m_data, n);
+            m_data += n;
+            m_size -= n;
+        }
+
+        template <class T>
+        T consume();
+
+    private:
+        const uint8_t* m_data;
+        size_t         m_size;
+    };
+
+    template <class T, class Enable = void>
+    struct Decode;
+
+    template <class T>
+    T FuzzInput::consume()
+    {
+        return Decode<T>::decode(*this);
+    }
+
+    template <class T>
+    struct Decode<T, std::enable_if_t<std::is_arithmetic<T>::value && !std::is_same<T, bool>::value>>
+    {
+        static T decode(FuzzInput& input)
+        {
+            auto value = T{};
+            input.bytes(&value, sizeof(value));
+            return value;
+        }
+    };
+
+    template <>
+    struct Decode<bool>
+    {
+        static bool decode(FuzzInput& input)
+        {
+            return (input.byte() & 1) != 0;
+        }
+    };
+
+    // A string of any length, it ends at a backslash followed by anything other than a backslash or at the end of
+    // the input, two backslashes are one backslash. This is the encoding libFuzzer's FuzzedDataProvider uses, small
+    // mutations of the input make small changes to the string.
+    template <>
+    struct Decode<std::string>
+    {
+        static std::string decode(FuzzInput& input)
+        {
+            auto s = std::string{};
+            while (input.remaining() != 0)
+            {
+                auto c = static_cast<char>(input.byte());
+                if (c == '\\' && input.remaining() != 0)
+                {
+                    c = static_cast<char>(input.byte());
+                    if (c != '\\')
+                        break;
+                }
+                s += c;
+            }
+            return s;
+        }
+    };
+
+    // a 16 bit count then the elements, the count is limited by what is left of the input
+    template <class T>
+    struct Decode<std::vector<T>>
+    {
+        static std::vector<T> decode(FuzzInput& input)
+        {
+            auto v = std::vector<T>{};
+            for (auto n = input.consume<uint16_t>(); n != 0 && input.remaining() != 0; --n)
+                v.push_back(input.consume<T>());
+            return v;
+        }
+    };
+
+    template <class First, class Second>
+    struct Decode<std::pair<First, Second>>
+    {
+        static std::pair<First, Second> decode(FuzzInput& input)
+        {
+            auto first = input.consume<First>();
+            return {first, input.consume<Second>()};
+        }
+    };
+
+    template <class... Ts>
+    struct Decode<std::tuple<Ts...>>
+    {
+        static std::tuple<Ts...> decode(FuzzInput& input)
+        {
+            // braces so the elements are decoded in order
+            return std::tuple<Ts...>{input.consume<Ts>()...};
+        }
+    };
+
+    // A FUZZ_TEST as libFuzzer sees it, they are linked into a list as the program starts.
+    struct FuzzTarget
+    {
+        const char* name;
+        void (*run)(const uint8_t* data, size_t size);
+        FuzzTarget* next;
+    };
+
+    inline FuzzTarget*& FuzzTargets()
+    {
+        static FuzzTarget* first = nullptr;
+        return first;
+    }
+
+    inline size_t AddFuzzTarget(FuzzTarget& target)
+    {
+        auto last = &FuzzTargets();
+        while (*last != nullptr)
+            last = &(*last)->next;
+        *last = &target;
+        return 0;
+    }
+
+    template <class Property>
+    struct FuzzTest
+    {
+        // a failed EXPECT_* is thrown once the input has been run, so the fuzzer sees it as a crash as it would an
+        // assertion
+        static void run(const uint8_t* data, size_t size)
+        {
+            RecordingScope recording;
+            auto           input = FuzzInput(data, size);
+            Property()(input.consume<typename Property::args_type>());
+
+            auto msg = std::string{};
+            for (auto& failure : recording.take())
+                msg += std::string(failure.what()) + "\n";
+            if (!msg.empty())
+                throw std::runtime_error(msg.substr(0, msg.size() - 1));
+        }
+    };
+} // namespace UnitTests
+
+#define FUZZ_TEST(name, ...)                                                                            \
+    struct name                                                                                         \
+    {                                                                                                   \
+        using args_type = std::tuple<__VA_ARGS__>;                                                      \
+        void operator()(const args_type& args) const;                                                   \
+    };                                                                                                  \
+    namespace                                                                                           \
+    {                                                                                                   \
+        namespace PP_CAT(unique, __LINE__)                                                              \
+        {                                                                                               \
+            UnitTests::MiniSuite::Node node(test_suite, #name, __FILE__, __LINE__,                      \
+                &UnitTests::PropertyTest<name>::run, &UnitTests::PropertyTest<name>::count, nullptr);   \
+            const size_t ignore_this_warning = UnitTests::MiniSuite::Instance().AddTest(node);          \
+            UnitTests::FuzzTarget target{#name, &UnitTests::FuzzTest<name>::run, nullptr};              \
+            const size_t ignore_this_warning_too = UnitTests::AddFuzzTarget(target);                    \
+        }                                                                                               \
+    }                                                                                                   \
+    void name::operator()(const args_type& args) const /**/
+
+#if defined(TEST_FUZZ_MAIN)
+#include "fuzzmain.inl"
+#endif
+
+#endif
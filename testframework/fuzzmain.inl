@@ -0,0 +1,89 @@
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <exception>
+#include <fstream>
+#include <iterator>
+#include <vector>
+
+namespace UnitTests
+{
+    // The FUZZ_TEST named by the FUZZ_TEST environment variable, or null to pick one with the first byte of each input.
+    FuzzTarget* ChosenFuzzTarget()
+    {
+        static auto chosen = []() -> FuzzTarget* {
+            auto name = std::getenv("FUZZ_TEST");
+            if (name == nullptr || *name == '\0')
+                return nullptr;
+
+            for (auto target = FuzzTargets(); target != nullptr; target = target->next)
+            {
+                if (std::strcmp(target->name, name) == 0)
+                    return target;
+            }
+            std::fprintf(stderr, "There is no FUZZ_TEST called %s\n", name);
+            std::exit(1);
+        }();
+        return chosen;
+    }
+
+    void RunFuzzInput(const uint8_t* data, size_t size)
+    {
+        auto target = ChosenFuzzTarget();
+        if (target == nullptr)
+        {
+            auto count = size_t{0};
+            for (auto t = FuzzTargets(); t != nullptr; t = t->next)
+                ++count;
+            if (count == 0 || (count > 1 && size == 0))
+                return;
+
+            target = FuzzTargets();
+            if (count > 1)
+            {
+                for (auto n = *data % count; n != 0; --n)
+                    target = target->next;
+                ++data;
+                --size;
+            }
+        }
+
+        // a failure is a crash as far as the fuzzer is concerned, it keeps the input that caused it
+        try
+        {
+            target->run(data, size);
+        }
+        catch (const std::exception& e)
+        {
+            std::fprintf(stderr, "FUZZ_TEST(%s) failed : %s\n", target->name, e.what());
+            std::abort();
+        }
+        catch (...)
+        {
+            std::fprintf(stderr, "FUZZ_TEST(%s) failed : Unknown exception\n", target->name);
+            std::abort();
+        }
+    }
+} // namespace UnitTests
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t* data, size_t size)
+{
+    UnitTests::RunFuzzInput(data, size);
+    return 0;
+}
+
+#if defined(TEST_FUZZ_STANDALONE)
+// Without libFuzzer (e.g. when not building with clang) each file named on the command line is run as an input, so
+// inputs the fuzzer saved can still be reproduced.
+int main(int argc, char** argv)
+{
+    for (auto arg = 1; arg < argc; ++arg)
+    {
+        auto file  = std::ifstream(argv[arg], std::ios::binary);
+        auto bytes = std::vector<char>(std::istreambuf_iterator<char>(file), {});
+        std::printf("Running %s (%zu bytes)\n", argv[arg], bytes.size());
+        LLVMFuzzerTestOneInput(reinterpret_cast<const uint8_t*>(bytes.data()), bytes.size());
+    }
+    return 0;
+}
+#endif
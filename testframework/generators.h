@@ -0,0 +1,295 @@
+#if !defined(TestFramework_generators_h_)
+#define TestFramework_generators_h_
+#include <cstddef>
+#include <iterator>
+#include <stdexcept>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace UnitTests
+{
+    // A view of the parameters of a PARAM_TEST held somewhere else, so a static table is used in place rather than
+    // copied. Only PARAM_TEST_VIEW, or passing a ParamView yourself, makes one, as the table must outlive the run.
+    template <class Iterator>
+    class ParamView
+    {
+    public:
+        using value_type     = typename std::iterator_traits<Iterator>::value_type;
+        using const_iterator = Iterator;
+
+        ParamView(Iterator first, Iterator last) : m_begin(first), m_end(last)
+        {
+        }
+
+        Iterator begin() const
+        {
+            return m_begin;
+        }
+
+        Iterator end() const
+        {
+            return m_end;
+        }
+
+    private:
+        Iterator m_begin;
+        Iterator m_end;
+    };
+
+    template <class Container>
+    auto MakeParamView(const Container& cont)
+    {
+        using std::begin;
+        using std::end;
+        return ParamView<decltype(begin(cont))>(begin(cont), end(cont));
+    }
+
+    // The parameters of a PARAM_TEST made on demand, the i-th of `size` parameters is `fn(i)`. The parameters are not
+    // stored, each is made as its case runs, and a filtered or sharded run only makes the ones it runs. The runner
+    // still keeps a small work item (and its expected duration) for every index it runs, so a run's memory grows with
+    // the number of parameters, though not with their size. e.g. :
+    //               PARAM_TEST(round_trips, UnitTests::range(0, 1000000))
+    //               {
+    //                  ASSERT_EQUAL(args, parse(format(args)));
+    //               }
+    //  or a cartesian product, where args is a std::tuple :
+    //               const char* names[] = {"a", "b"};
+    //               PARAM_TEST(all_pairs, UnitTests::cartesian(names, UnitTests::range(0, 10)))
+    //               {
+    //                  check(std::get<0>(args), std::get<1>(args));
+    //               }
+    //  or a function of the index :
+    //               PARAM_TEST(squares, UnitTests::generate(100, [](size_t i) { return i * i; }))
+    //
+    template <class Function>
+    class Generator
+    {
+    public:
+        using value_type = std::decay_t<decltype(std::declval<const Function&>()(size_t{}))>;
+
+        class const_iterator
+        {
+        public:
+            using iterator_category = std::random_access_iterator_tag;
+            using value_type        = Generator::value_type;
+            using difference_type   = std::ptrdiff_t;
+            using pointer           = void;
+            using reference         = value_type;
+
+            const_iterator(const Generator* generator, size_t index) : m_generator(generator), m_index(index)
+            {
+            }
+
+            value_type operator*() const
+            {
+                return m_generator->m_fn(m_index);
+            }
+
+            value_type operator[](difference_type n) const
+            {
+                return *(*this + n);
+            }
+
+            const_iterator& operator++()
+            {
+                ++m_index;
+                return *this;
+            }
+
+            const_iterator& operator--()
+            {
+                --m_index;
+                return *this;
+            }
+
+            const_iterator& operator+=(difference_type n)
+            {
+                m_index += n;
+                return *this;
+            }
+
+            const_iterator operator+(difference_type n) const
+            {
+                return const_iterator(m_generator, m_index + n);
+            }
+
+            difference_type operator-(const const_iterator& other) const
+            {
+                return static_cast<difference_type>(m_index) - static_cast<difference_type>(other.m_index);
+            }
+
+            bool operator==(const const_iterator& other) const
+            {
+                return m_index == other.m_index;
+            }
+
+            bool operator!=(const const_iterator& other) const
+            {
+                return m_index != other.m_index;
+            }
+
+            bool operator<(const const_iterator& other) const
+            {
+                return m_index < other.m_index;
+            }
+
+        private:
+            const Generator* m_generator;
+            size_t           m_index;
+        };
+
+        Generator(size_t size, Function fn) : m_size(size), m_fn(std::move(fn))
+        {
+        }
+
+        size_t size() const
+        {
+            return m_size;
+        }
+
+        value_type operator[](size_t index) const
+        {
+            return m_fn(index);
+        }
+
+        const_iterator begin() const
+        {
+            return const_iterator(this, 0);
+        }
+
+        const_iterator end() const
+        {
+            return const_iterator(this, m_size);
+        }
+
+    private:
+        size_t   m_size;
+        Function m_fn;
+    };
+
+    template <class Function>
+    Generator<Function> generate(size_t size, Function fn)
+    {
+        return Generator<Function>(size, std::move(fn));
+    }
+
+    // first, first + step, ... up to but not including last
+    template <class T>
+    auto range(T first, T last, T step = 1)
+    {
+        static_assert(std::is_integral<T>::value, "range needs an integral type");
+        if (step == 0)
+            throw std::invalid_argument("The step of a range can not be zero.");
+
+        auto size = T{0};
+        if (step > 0 && first < last)
+            size = (last - first + step - 1) / step;
+        else if (step < 0 && last < first)
+            size = (first - last + (T{0} - step) - 1) / (T{0} - step);
+        return generate(static_cast<size_t>(size),
+            [first, step](size_t index) { return static_cast<T>(first + static_cast<T>(index) * step); });
+    }
+
+    namespace detail
+    {
+        // a copy of an lvalue list of parameters, which may not outlive the run, an array is copied into a vector
+        template <class Source>
+        Source CopyParams(const Source& source)
+        {
+            return source;
+        }
+
+        template <class T, size_t N>
+        std::vector<T> CopyParams(const T (&source)[N])
+        {
+            return std::vector<T>(std::begin(source), std::end(source));
+        }
+
+        // a list of values to combine is copied, a temporary is moved in and a ParamView is used as it is
+        template <class Source>
+        auto ParamSource(const Source& source)
+        {
+            return CopyParams(source);
+        }
+
+        template <class Source, std::enable_if_t<!std::is_lvalue_reference<Source>::value, int> = 0>
+        std::decay_t<Source> ParamSource(Source&& source)
+        {
+            return std::move(source);
+        }
+
+        template <class Source>
+        size_t SourceSize(const Source& source)
+        {
+            using std::begin;
+            using std::end;
+            return static_cast<size_t>(end(source) - begin(source));
+        }
+
+        // The i-th combination of the values in Sources, the last source varying fastest. Each source must be random
+        // access.
+        template <class... Sources>
+        class Cartesian
+        {
+        public:
+            using value_type = std::tuple<
+                typename std::iterator_traits<decltype(std::begin(std::declval<const Sources&>()))>::value_type...>;
+
+            explicit Cartesian(Sources... sources) : m_sources(std::move(sources)...)
+            {
+            }
+
+            size_t size() const
+            {
+                return size(std::index_sequence_for<Sources...>{});
+            }
+
+            value_type operator()(size_t index) const
+            {
+                return at(index, std::index_sequence_for<Sources...>{});
+            }
+
+        private:
+            template <size_t... I>
+            size_t size(std::index_sequence<I...>) const
+            {
+                auto total = size_t{1};
+                for (auto size : {SourceSize(std::get<I>(m_sources))...})
+                    total *= size;
+                return total;
+            }
+
+            template <size_t... I>
+            value_type at(size_t index, std::index_sequence<I...>) const
+            {
+                size_t sizes[]               = {SourceSize(std::get<I>(m_sources))...};
+                size_t indexes[sizeof...(I)] = {};
+                for (auto n = sizeof...(I); n-- != 0;)
+                {
+                    indexes[n] = index % sizes[n];
+                    index /= sizes[n];
+                }
+                using std::begin;
+                return value_type(begin(std::get<I>(m_sources))[static_cast<std::ptrdiff_t>(indexes[I])]...);
+            }
+
+            std::tuple<Sources...> m_sources;
+        };
+    } // namespace detail
+
+    // every combination of one value from each of `sources`, as a std::tuple
+    template <class Source, class... Sources>
+    auto cartesian(Source&& source, Sources&&... sources)
+    {
+        using Product = detail::Cartesian<decltype(detail::ParamSource(std::forward<Source>(source))),
+            decltype(detail::ParamSource(std::forward<Sources>(sources)))...>;
+        auto product = Product(detail::ParamSource(std::forward<Source>(source)),
+            detail::ParamSource(std::forward<Sources>(sources))...);
+        auto size = product.size();
+        return generate(size, std::move(product));
+    }
+} // namespace UnitTests
+
+#endif
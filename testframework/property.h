@@ -0,0 +1,429 @@
+#if !defined(TestFramework_property_h_)
+#define TestFramework_property_h_
+#include "MiniTestFramework.h"
+#include "streamfortestoutput.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <limits>
+#include <sstream>
+#include <string>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace UnitTests
+{
+    // use PROPERTY_TEST to check something holds for randomly generated arguments of the given types, e.g. :
+    //               PROPERTY_TEST(reversing_twice_changes_nothing, std::vector<int>)
+    //               {
+    //                  auto v = std::get<0>(args);
+    //                  std::reverse(begin(v), end(v));
+    //                  std::reverse(begin(v), end(v));
+    //                  ASSERT_EQUALS(std::get<0>(args), v);
+    //               }
+    //
+    // args is a std::tuple of the types. --property-cases N sets the number of cases run for each property (1000 by
+    // default), they are split into batches that are run like the indexes of a PARAM_TEST, so --jobs spreads them
+    // over threads. Each case is made from --seed and its number alone, so a failure is reproduced by running with
+    // the seed given in the failure. A failing case is shrunk to a minimal counterexample before it is reported.
+    //
+    // Specialise Arbitrary for your own types.
+
+    // SplitMix64, small and fast with a 64 bit seed
+    class PropertyRandom
+    {
+    public:
+        using result_type = uint64_t;
+
+        explicit PropertyRandom(uint64_t seed) : m_state(seed)
+        {
+        }
+
+        static constexpr result_type min()
+        {
+            return 0;
+        }
+
+        static constexpr result_type max()
+        {
+            return std::numeric_limits<result_type>::max();
+        }
+
+        result_type operator()()
+        {
+            auto z = (m_state += 0x9e3779b97f4a7c15ULL);
+            z      = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+            z      = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+            return z ^ (z >> 31);
+        }
+
+        // a number in [0, n)
+        uint64_t below(uint64_t n)
+        {
+            return n == 0 ? 0 : (*this)() % n;
+        }
+
+        bool one_in(uint64_t n)
+        {
+            return below(n) == 0;
+        }
+
+    private:
+        uint64_t m_state;
+    };
+
+    // Makes random values of T, `size` grows from 0 as the cases go on so the early cases are small. shrink returns
+    // simpler values to try in place of a failing one, simplest first.
+    template <class T, class Enable = void>
+    struct Arbitrary;
+
+    template <class T>
+    struct Arbitrary<T, std::enable_if_t<std::is_integral<T>::value && !std::is_same<T, bool>::value>>
+    {
+        static T generate(PropertyRandom& random, int size)
+        {
+            if (random.one_in(8))
+            {
+                using limits    = std::numeric_limits<T>;
+                const T edges[] = {T(0), T(1), limits::min(), limits::max(), static_cast<T>(limits::min() + 1),
+                    static_cast<T>(limits::max() - 1)};
+                return edges[random.below(sizeof(edges) / sizeof(edges[0]))];
+            }
+            if (random.one_in(4))
+                return static_cast<T>(random());
+
+            auto value = static_cast<T>(random.below(static_cast<uint64_t>(size) + 1));
+            return std::is_signed<T>::value && random.one_in(2) ? static_cast<T>(T(0) - value) : value;
+        }
+
+        static std::vector<T> shrink(T value)
+        {
+            auto smaller = std::vector<T>{};
+            if (value == 0)
+                return smaller;
+
+            smaller.push_back(0);
+            if (value < 0 && value != std::numeric_limits<T>::min())
+                smaller.push_back(static_cast<T>(T(0) - value));
+            for (auto half = static_cast<T>(value / 2); half != 0; half = static_cast<T>(half / 2))
+                smaller.push_back(static_cast<T>(value - half));
+            return smaller;
+        }
+    };
+
+    template <>
+    struct Arbitrary<bool>
+    {
+        static bool generate(PropertyRandom& random, int /*unused*/)
+        {
+            return random.one_in(2);
+        }
+
+        static std::vector<bool> shrink(bool value)
+        {
+            return value ? std::vector<bool>{false} : std::vector<bool>{};
+        }
+    };
+
+    template <class T>
+    struct Arbitrary<T, std::enable_if_t<std::is_floating_point<T>::value>>
+    {
+        static T generate(PropertyRandom& random, int size)
+        {
+            if (random.one_in(8))
+            {
+                const T edges[] = {T(0), T(1), T(-1), std::numeric_limits<T>::min(), std::numeric_limits<T>::max(),
+                    std::numeric_limits<T>::lowest(), std::numeric_limits<T>::epsilon()};
+                return edges[random.below(sizeof(edges) / sizeof(edges[0]))];
+            }
+            auto unit = static_cast<T>(random() >> 11) / static_cast<T>(1ULL << 53);
+            return (unit * 2 - 1) * static_cast<T>(size + 1);
+        }
+
+        static std::vector<T> shrink(T value)
+        {
+            auto smaller = std::vector<T>{};
+            if (value == 0 || value != value)
+                return smaller;
+
+            smaller.push_back(0);
+            if (value < 0)
+                smaller.push_back(-value);
+            if (value > T(-1e18) && value < T(1e18))
+            {
+                auto whole = static_cast<T>(static_cast<long long>(value));
+                if (whole != value)
+                    smaller.push_back(whole);
+            }
+            smaller.push_back(value / 2);
+            return smaller;
+        }
+    };
+
+    template <>
+    struct Arbitrary<std::string>
+    {
+        static std::string generate(PropertyRandom& random, int size)
+        {
+            auto s = std::string(random.below(static_cast<uint64_t>(size) + 1), ' ');
+            for (auto& c : s)
+                c = random.one_in(16) ? static_cast<char>(random()) : static_cast<char>(' ' + random.below(95));
+            return s;
+        }
+
+        static std::vector<std::string> shrink(const std::string& value)
+        {
+            auto smaller = std::vector<std::string>{};
+            if (value.empty())
+                return smaller;
+
+            smaller.emplace_back();
+            if (value.size() > 1)
+            {
+                smaller.push_back(value.substr(0, value.size() / 2));
+                smaller.push_back(value.substr(value.size() / 2));
+            }
+            for (auto i = size_t{0}; i != value.size(); ++i)
+                smaller.push_back(value.substr(0, i) + value.substr(i + 1));
+            for (auto i = size_t{0}; i != value.size(); ++i)
+            {
+                if (value[i] != 'a')
+                {
+                    auto simpler = value;
+                    simpler[i]   = 'a';
+                    smaller.push_back(simpler);
+                }
+            }
+            return smaller;
+        }
+    };
+
+    template <class T>
+    struct Arbitrary<std::vector<T>>
+    {
+        static std::vector<T> generate(PropertyRandom& random, int size)
+        {
+            auto v = std::vector<T>{};
+            for (auto n = random.below(static_cast<uint64_t>(size) + 1); n != 0; --n)
+                v.push_back(Arbitrary<T>::generate(random, size));
+            return v;
+        }
+
+        static std::vector<std::vector<T>> shrink(const std::vector<T>& value)
+        {
+            auto smaller = std::vector<std::vector<T>>{};
+            if (value.empty())
+                return smaller;
+
+            smaller.emplace_back();
+            auto middle = begin(value) + static_cast<std::ptrdiff_t>(value.size() / 2);
+            if (value.size() > 1)
+            {
+                smaller.emplace_back(begin(value), middle);
+                smaller.emplace_back(middle, end(value));
+            }
+            for (auto i = size_t{0}; i != value.size(); ++i)
+            {
+                smaller.push_back(value);
+                smaller.back().erase(smaller.back().begin() + static_cast<std::ptrdiff_t>(i));
+            }
+            for (auto i = size_t{0}; i != value.size(); ++i)
+            {
+                for (auto& element : Arbitrary<T>::shrink(value[i]))
+                {
+                    smaller.push_back(value);
+                    smaller.back()[i] = element;
+                }
+            }
+            return smaller;
+        }
+    };
+
+    template <class First, class Second>
+    struct Arbitrary<std::pair<First, Second>>
+    {
+        static std::pair<First, Second> generate(PropertyRandom& random, int size)
+        {
+            auto first = Arbitrary<First>::generate(random, size);
+            return {first, Arbitrary<Second>::generate(random, size)};
+        }
+
+        static std::vector<std::pair<First, Second>> shrink(const std::pair<First, Second>& value)
+        {
+            auto smaller = std::vector<std::pair<First, Second>>{};
+            for (auto& first : Arbitrary<First>::shrink(value.first))
+                smaller.emplace_back(first, value.second);
+            for (auto& second : Arbitrary<Second>::shrink(value.second))
+                smaller.emplace_back(value.first, second);
+            return smaller;
+        }
+    };
+
+    // each element is shrunk in turn with the others left as they are
+    template <class... Ts>
+    struct Arbitrary<std::tuple<Ts...>>
+    {
+        static std::tuple<Ts...> generate(PropertyRandom& random, int size)
+        {
+            // braces so the elements are made in order, which keeps a case the same on every compiler
+            return std::tuple<Ts...>{Arbitrary<Ts>::generate(random, size)...};
+        }
+
+        static std::vector<std::tuple<Ts...>> shrink(const std::tuple<Ts...>& value)
+        {
+            auto smaller = std::vector<std::tuple<Ts...>>{};
+            shrink_elements(value, smaller, std::index_sequence_for<Ts...>{});
+            return smaller;
+        }
+
+    private:
+        template <size_t... I>
+        static void shrink_elements(
+            const std::tuple<Ts...>& value, std::vector<std::tuple<Ts...>>& smaller, std::index_sequence<I...>)
+        {
+            using expand = int[];
+            (void)expand{0, (shrink_element<I>(value, smaller), 0)...};
+        }
+
+        template <size_t I>
+        static void shrink_element(const std::tuple<Ts...>& value, std::vector<std::tuple<Ts...>>& smaller)
+        {
+            using Element = std::tuple_element_t<I, std::tuple<Ts...>>;
+            for (auto& element : Arbitrary<Element>::shrink(std::get<I>(value)))
+            {
+                smaller.push_back(value);
+                std::get<I>(smaller.back()) = element;
+            }
+        }
+    };
+
+    // Runs the cases of a PROPERTY_TEST, Property is the struct the macro declares.
+    template <class Property>
+    class PropertyTest
+    {
+    public:
+        using args_type = typename Property::args_type;
+
+        static constexpr int cases_per_batch = 250;
+
+        static int count(const MiniSuite::Node& /*unused*/)
+        {
+            auto cases = CurrentPropertySettings().cases;
+            return cases <= 0 ? 1 : (cases + cases_per_batch - 1) / cases_per_batch;
+        }
+
+        static void run(const MiniSuite::Node& node, int batch)
+        {
+            auto settings = CurrentPropertySettings();
+            auto first    = batch * cases_per_batch;
+            auto last     = std::min(settings.cases, first + cases_per_batch);
+            auto base     = settings.seed ^ hash(node.Suite(), node.BareName());
+            for (auto number = first; number < last; ++number)
+            {
+                auto random = PropertyRandom(base + static_cast<uint64_t>(number) * 0x9e3779b97f4a7c15ULL);
+                auto args   = Arbitrary<args_type>::generate(random, number % 100);
+                auto msg    = std::string{};
+                if (!holds(args, msg))
+                    report(node, args, msg, number, settings.seed);
+            }
+        }
+
+    private:
+        static uint64_t hash(const char* suite, const char* name)
+        {
+            auto hash = 14695981039346656037ULL;
+            for (auto s : {suite, ".", name})
+            {
+                for (; *s != '\0'; ++s)
+                    hash = (hash ^ static_cast<unsigned char>(*s)) * 1099511628211ULL;
+            }
+            return hash;
+        }
+
+        // a case holds if it neither throws nor records an EXPECT_* failure, `msg` gets the messages of those it does
+        static bool holds(const args_type& args, std::string& msg)
+        {
+            RecordingScope recording;
+            auto           held = false;
+            try
+            {
+                Property()(args);
+                held = true;
+            }
+            catch (const TestFailure& e)
+            {
+                msg = e.msg();
+            }
+            catch (const std::exception& e)
+            {
+                msg = std::string(" Unexpected exception : ") + e.what();
+            }
+            catch (...)
+            {
+                msg = " Unknown exception";
+            }
+
+            auto recorded = std::string{};
+            for (auto& failure : recording.take())
+                recorded += failure.msg() + "\n";
+            if (recorded.empty())
+                return held;
+
+            recorded.pop_back();
+            msg = held ? recorded : recorded + "\n" + msg;
+            return false;
+        }
+
+        // takes the first simpler args that still fail until none do
+        [[noreturn]] static void report(
+            const MiniSuite::Node& node, args_type args, std::string msg, int number, uint64_t seed)
+        {
+            auto shrinks = 0;
+            for (auto shrinking = true; shrinking && shrinks != 10000;)
+            {
+                shrinking = false;
+                for (auto& simpler : Arbitrary<args_type>::shrink(args))
+                {
+                    auto simpler_msg = std::string{};
+                    if (!holds(simpler, simpler_msg))
+                    {
+                        args      = simpler;
+                        msg       = simpler_msg;
+                        shrinking = true;
+                        ++shrinks;
+                        break;
+                    }
+                }
+            }
+
+            std::stringstream s;
+            s << "Property falsified by " << stream(args) << " (case " << number << " shrunk " << shrinks
+              << " times, reproduce with --seed " << seed << ") :" << msg;
+            throw TestFailure(s.str(), node.File(), node.Line());
+        }
+    };
+
+    template <class Property>
+    constexpr int PropertyTest<Property>::cases_per_batch;
+} // namespace UnitTests
+
+#define PROPERTY_TEST(name, ...)                                                                        \
+    struct name                                                                                         \
+    {                                                                                                   \
+        using args_type = std::tuple<__VA_ARGS__>;                                                      \
+        void operator()(const args_type& args) const;                                                   \
+    };                                                                                                  \
+    namespace                                                                                           \
+    {                                                                                                   \
+        namespace PP_CAT(unique, __LINE__)                                                              \
+        {                                                                                               \
+            UnitTests::MiniSuite::Node node(test_suite, #name, __FILE__, __LINE__,                      \
+                &UnitTests::PropertyTest<name>::run, &UnitTests::PropertyTest<name>::count, nullptr);   \
+            const size_t ignore_this_warning = UnitTests::MiniSuite::Instance().AddTest(node);          \
+        }                                                                                               \
+    }                                                                                                   \
+    void name::operator()(const args_type& args) const /**/
+
+#endif
@@ -0,0 +1,419 @@
+#if !defined(TestFramework_resultslog_h_)
+#define TestFramework_resultslog_h_
+#include "escape.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <iterator>
+#include <ostream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#if defined(__unix__) || defined(__APPLE__)
+#define TESTFRAMEWORK_HAS_MMAP
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace UnitTests
+{
+    // FNV-1a, used to give each work item a hash that stays the same from one run, build or platform to the next
+    inline uint64_t StableHash(const char* data, size_t size, uint64_t hash = 14695981039346656037ULL)
+    {
+        for (auto p = data; p != data + size; ++p)
+        {
+            hash = (hash ^ static_cast<unsigned char>(*p)) * 1099511628211ULL;
+        }
+        return hash;
+    }
+
+    // The results log --results-bin FILE writes is made to be written quickly and searched without reading all of it :
+    // a Header, then a Record for each test in the order they ended, then a heap of the NUL terminated strings the
+    // records refer to by their offset from the start of the heap. Finding e.g. the failures in a suite is a scan of
+    // the records comparing hashes, only the strings of the records that match are looked at.
+    namespace results_log
+    {
+        constexpr char     magic[8]    = {'T', 'F', 'R', 'E', 'S', 'U', 'L', 'T'};
+        constexpr uint32_t version     = 1;
+        constexpr uint64_t no_string   = ~uint64_t{0};
+        constexpr size_t   header_size = 40;
+
+        // as Reporter has them
+        enum Status : uint32_t
+        {
+            Passed,
+            Failed,
+            Skipped,
+            Error
+        };
+
+        struct Header
+        {
+            char     magic[8];
+            uint32_t version;
+            uint32_t record_size;
+            uint64_t records;
+            uint64_t heap_offset;
+            uint64_t heap_size;
+        };
+
+        struct Record
+        {
+            uint64_t suite_hash; // SuiteHash(suite)
+            uint64_t test_hash;  // TestHash(suite, name)
+            int64_t  wall_time;  // nanoseconds
+            int64_t  cpu_time;   // nanoseconds
+            uint64_t suite;      // offsets of the strings in the heap
+            uint64_t name;
+            uint64_t message;
+            uint32_t status;
+            uint32_t reserved;
+        };
+
+        static_assert(sizeof(Header) == header_size, "the results log header must have no padding");
+        static_assert(sizeof(Record) == 64, "the results log records must have no padding");
+
+        inline const char* StatusName(uint32_t status)
+        {
+            static const char* const names[] = {"passed", "failed", "skipped", "error"};
+            return names[status & 3];
+        }
+
+        inline uint64_t SuiteHash(const std::string& suite)
+        {
+            return StableHash(suite.c_str(), suite.size() + 1);
+        }
+
+        inline uint64_t TestHash(const std::string& suite, const std::string& name)
+        {
+            return StableHash(name.c_str(), name.size() + 1, SuiteHash(suite));
+        }
+    } // namespace results_log
+
+#if defined(TESTFRAMEWORK_HAS_MMAP)
+    // Writes a results log. The records go straight into a memory mapping of the file, which doubles in size when it
+    // is full, the strings are written to FILE.heap alongside it and copied on to the end by close(). If the run never
+    // gets that far the header still has the number of records written, but their strings are missing.
+    class ResultsLogWriter
+    {
+    public:
+        explicit ResultsLogWriter(const std::string& filename)
+            : m_filename(filename), m_heap(filename + ".heap", std::ios::binary)
+        {
+            m_fd = ::open(filename.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+            try
+            {
+                if (m_fd < 0 || !m_heap)
+                    throw std::runtime_error("Unable to create the results log " + filename + ".");
+                map(1024);
+            }
+            catch (...)
+            {
+                if (m_fd >= 0)
+                    ::close(m_fd);
+                m_heap.close();
+                std::remove((filename + ".heap").c_str());
+                throw;
+            }
+
+            auto header = results_log::Header{};
+            std::memcpy(header.magic, results_log::magic, sizeof header.magic);
+            header.version     = results_log::version;
+            header.record_size = sizeof(results_log::Record);
+            std::memcpy(m_map, &header, sizeof header);
+        }
+
+        ResultsLogWriter(const ResultsLogWriter&) = delete;
+        ResultsLogWriter& operator=(const ResultsLogWriter&) = delete;
+
+        ~ResultsLogWriter()
+        {
+            try
+            {
+                close();
+            }
+            catch (...)
+            {
+            }
+        }
+
+        // the offset of `s` in the heap
+        uint64_t add_string(const std::string& s)
+        {
+            auto offset = m_heap_size;
+            m_heap.write(s.c_str(), static_cast<std::streamsize>(s.size() + 1));
+            m_heap_size += s.size() + 1;
+            return offset;
+        }
+
+        void add(const results_log::Record& record)
+        {
+            if (m_records == m_capacity)
+                map(m_capacity * 2);
+            std::memcpy(m_map + results_log::header_size + m_records * sizeof record, &record, sizeof record);
+            ++m_records;
+            std::memcpy(m_map + offsetof(results_log::Header, records), &m_records, sizeof m_records);
+        }
+
+        // moves the heap on to the end of the records and finishes the header
+        void close()
+        {
+            if (m_fd < 0)
+                return;
+
+            ::munmap(m_map, mapped_size(m_capacity));
+            m_map      = nullptr;
+            auto fd    = m_fd;
+            m_fd       = -1;
+            auto heap  = m_filename + ".heap";
+            auto end   = results_log::header_size + m_records * sizeof(results_log::Record);
+            auto ok    = m_heap.flush().good() && ::ftruncate(fd, static_cast<off_t>(end)) == 0;
+            auto bytes = std::ifstream(heap, std::ios::binary);
+            char buffer[65536];
+            for (auto offset = static_cast<off_t>(end); ok && bytes.read(buffer, sizeof buffer).gcount() != 0;)
+            {
+                ok = write_fully(fd, buffer, static_cast<size_t>(bytes.gcount()), offset);
+                offset += bytes.gcount();
+            }
+            bytes.close();
+            m_heap.close();
+            std::remove(heap.c_str());
+
+            auto heap_offset = static_cast<uint64_t>(end);
+            ok = ok && write_fully(fd, &heap_offset, sizeof heap_offset, offsetof(results_log::Header, heap_offset)) &&
+                 write_fully(fd, &m_heap_size, sizeof m_heap_size, offsetof(results_log::Header, heap_size));
+            ok = ::close(fd) == 0 && ok;
+            if (!ok)
+                throw std::runtime_error("Unable to write the results log " + m_filename + ".");
+        }
+
+    private:
+        static size_t mapped_size(uint64_t capacity)
+        {
+            return static_cast<size_t>(results_log::header_size + capacity * sizeof(results_log::Record));
+        }
+
+        // maps room for `capacity` records
+        void map(uint64_t capacity)
+        {
+            if (m_map != nullptr)
+                ::munmap(m_map, mapped_size(m_capacity));
+            m_map = nullptr;
+            if (::ftruncate(m_fd, static_cast<off_t>(mapped_size(capacity))) != 0)
+                throw std::runtime_error("Unable to grow the results log " + m_filename + ".");
+
+            auto p = ::mmap(nullptr, mapped_size(capacity), PROT_READ | PROT_WRITE, MAP_SHARED, m_fd, 0);
+            if (p == MAP_FAILED)
+                throw std::runtime_error("Unable to map the results log " + m_filename + ".");
+            m_map      = static_cast<char*>(p);
+            m_capacity = capacity;
+        }
+
+        static bool write_fully(int fd, const void* data, size_t size, off_t offset)
+        {
+            auto p = static_cast<const char*>(data);
+            while (size != 0)
+            {
+                auto n = ::pwrite(fd, p, size, offset);
+                if (n < 0 && errno == EINTR)
+                    continue;
+                if (n <= 0)
+                    return false;
+                p += n;
+                size -= static_cast<size_t>(n);
+                offset += n;
+            }
+            return true;
+        }
+
+        std::string   m_filename;
+        std::ofstream m_heap;
+        uint64_t      m_heap_size = 0;
+        int           m_fd        = -1;
+        char*         m_map       = nullptr;
+        uint64_t      m_capacity  = 0;
+        uint64_t      m_records   = 0;
+    };
+#endif
+
+    // Reads a results log, memory mapped where that can be done. A string offset out of the heap, as it is for a log
+    // that was never closed, reads as an empty string.
+    class ResultsLog
+    {
+    public:
+        explicit ResultsLog(const std::string& filename)
+        {
+#if defined(TESTFRAMEWORK_HAS_MMAP)
+            auto        fd   = ::open(filename.c_str(), O_RDONLY);
+            struct stat info = {};
+            if (fd >= 0 && ::fstat(fd, &info) == 0 && info.st_size != 0)
+            {
+                m_size   = static_cast<size_t>(info.st_size);
+                auto map = ::mmap(nullptr, m_size, PROT_READ, MAP_SHARED, fd, 0);
+                m_data   = map == MAP_FAILED ? nullptr : static_cast<const char*>(map);
+            }
+            if (fd >= 0)
+                ::close(fd);
+            if (m_data == nullptr)
+                m_size = 0;
+#else
+            auto f = std::ifstream(filename, std::ios::binary);
+            m_copy.assign(std::istreambuf_iterator<char>(f), {});
+            m_data = m_copy.data();
+            m_size = m_copy.size();
+#endif
+            auto header = results_log::Header{};
+            if (m_size < sizeof header)
+                throw_invalid(filename);
+            std::memcpy(&header, m_data, sizeof header);
+            if (std::memcmp(header.magic, results_log::magic, sizeof header.magic) != 0 ||
+                header.version != results_log::version || header.record_size != sizeof(results_log::Record) ||
+                header.records > (m_size - sizeof header) / sizeof(results_log::Record))
+                throw_invalid(filename);
+
+            m_records = reinterpret_cast<const results_log::Record*>(m_data + sizeof header);
+            m_count   = static_cast<size_t>(header.records);
+            if (header.heap_offset <= m_size && header.heap_size <= m_size - header.heap_offset)
+            {
+                m_heap      = m_data + header.heap_offset;
+                m_heap_size = static_cast<size_t>(header.heap_size);
+            }
+        }
+
+        ResultsLog(const ResultsLog&) = delete;
+        ResultsLog& operator=(const ResultsLog&) = delete;
+
+        ~ResultsLog()
+        {
+#if defined(TESTFRAMEWORK_HAS_MMAP)
+            if (m_data != nullptr)
+                ::munmap(const_cast<char*>(m_data), m_size);
+#endif
+        }
+
+        size_t size() const
+        {
+            return m_count;
+        }
+
+        const results_log::Record* begin() const
+        {
+            return m_records;
+        }
+
+        const results_log::Record* end() const
+        {
+            return m_records + m_count;
+        }
+
+        std::string string(uint64_t offset) const
+        {
+            if (offset >= m_heap_size)
+                return std::string{};
+            auto s = m_heap + offset;
+            auto n = std::find(s, m_heap + m_heap_size, '\0') - s;
+            return std::string(s, static_cast<size_t>(n));
+        }
+
+    private:
+        static void throw_invalid(const std::string& filename)
+        {
+            throw std::runtime_error(filename + " is not a results log.");
+        }
+
+        const char*                m_data      = nullptr;
+        size_t                     m_size      = 0;
+        const results_log::Record* m_records   = nullptr;
+        size_t                     m_count     = 0;
+        const char*                m_heap      = nullptr;
+        size_t                     m_heap_size = 0;
+#if !defined(TESTFRAMEWORK_HAS_MMAP)
+        std::vector<char> m_copy;
+#endif
+    };
+
+    // The log as JUnit XML, as XMLReporter would have written it. A suite gets a <testsuite> for each run of its
+    // records, so the log is read twice rather than the totals being kept.
+    inline void WriteJUnit(const ResultsLog& log, std::ostream& s)
+    {
+        auto seconds = [](int64_t nanoseconds) {
+            auto text = std::ostringstream{};
+            text << std::fixed << std::setprecision(6) << static_cast<double>(nanoseconds) / 1e9;
+            return text.str();
+        };
+
+        s << "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n";
+        s << "<testsuites>\n";
+        auto id = 0;
+        for (auto first = log.begin(); first != log.end();)
+        {
+            auto last     = first;
+            int  counts[] = {0, 0, 0, 0};
+            auto time     = int64_t{0};
+            for (; last != log.end() && last->suite_hash == first->suite_hash; ++last)
+            {
+                ++counts[last->status & 3];
+                time += last->wall_time;
+            }
+
+            auto suite = log.string(first->suite);
+            s << "  <testsuite id=\"" << id++ << "\" name=\"" << XmlEscaped(suite, true) << "\" tests=\""
+              << last - first << "\" failures=\"" << counts[results_log::Failed] << "\" errors=\""
+              << counts[results_log::Error] << "\" skipped=\"" << counts[results_log::Skipped] << "\" time=\""
+              << seconds(time) << "\">\n";
+            for (; first != last; ++first)
+            {
+                s << "    <testcase classname=\"" << XmlEscaped(suite, true) << "\" name=\""
+                  << XmlEscaped(log.string(first->name), true) << "\" time=\"" << seconds(first->wall_time) << "\"";
+                if (first->status == results_log::Passed)
+                {
+                    s << " />\n";
+                    continue;
+                }
+
+                auto message = log.string(first->message);
+                s << ">\n";
+                if (first->status == results_log::Skipped)
+                    s << "      <skipped message=\"" << XmlEscaped(message, true) << "\"/>\n";
+                else if (first->status == results_log::Failed)
+                    s << "      <Failure message=\"Test Failure\">\n" << XmlEscaped(message) << "\n      </Failure>\n";
+                else
+                    s << "      <Error message=\"Unexpected Exception encountered\">\n"
+                      << XmlEscaped(message) << "\n      </Error>\n";
+                s << "    </testcase>\n";
+            }
+            s << "  </testsuite>\n";
+        }
+        s << "</testsuites>\n";
+    }
+
+    // The log as a JSON array with an object for each test.
+    inline void WriteJson(const ResultsLog& log, std::ostream& s)
+    {
+        s << "[";
+        for (auto record = log.begin(); record != log.end(); ++record)
+        {
+            s << (record == log.begin() ? "\n" : ",\n");
+            s << "  {\"suite\": \"" << JsonEscaped(log.string(record->suite)) << "\", \"name\": \""
+              << JsonEscaped(log.string(record->name)) << "\", \"status\": \""
+              << results_log::StatusName(record->status) << "\", \"wall_ns\": " << record->wall_time
+              << ", \"cpu_ns\": " << record->cpu_time;
+            if (record->message != results_log::no_string)
+                s << ", \"message\": \"" << JsonEscaped(log.string(record->message)) << "\"";
+            s << "}";
+        }
+        s << "\n]\n";
+    }
+} // namespace UnitTests
+
+#endif
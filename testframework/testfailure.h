@@ -12,44 +12,86 @@ namespace UnitTests
         AssertionFailure = 1000,
         TimeoutFailure,
         UnexpectedException,
-        UnknownUnexpectedException
+        UnknownUnexpectedException,
+        LeakFailure
     };
 
+    // The __FILE__ of an ASSERT_* or EXPECT_* macro. It lives as long as the program, so a failure can keep a pointer
+    // to it rather than a copy. Only the macros make one, any other file name is copied.
+    struct MacroFile
+    {
+        const char* name;
+    };
+
+    // A test failure from one of the macros keeps the parts of its message as they are given and puts them together
+    // the first time what() is called, so throwing and catching one costs little more than the message. The first
+    // call of what() must not race with another. A failure made with any other file name copies it and puts the
+    // message together at once.
     class TestFailure : public std::exception
     {
     public:
-        TestFailure(std::string msg, std::string file, int line, std::string failure_type, int error_code)
-            : m_what(FormatError(std::move(file), line, error_code) + std::move(failure_type) + std::move(msg)),
-              m_msg(std::move(msg))
+        TestFailure(std::string msg, const std::string& file, int line, const std::string& failure_type, int error_code)
+            : m_msg(std::move(msg)), m_line(line), m_error_code(error_code),
+              m_what(FormatError(file, line, error_code) + failure_type + m_msg)
+        {
+        }
+
+        TestFailure(std::string msg, const std::string& file, int line)
+            : TestFailure(std::move(msg), file, line, "Assertion failure : ", AssertionFailure)
         {
         }
 
-        TestFailure(std::string msg, std::string file, int line)
-            : TestFailure(std::move(msg), std::move(file), line, "Assertion failure : ", AssertionFailure)
+        TestFailure(std::string msg, MacroFile file, int line)
+            : m_msg(std::move(msg)), m_file(file.name), m_line(line), m_failure_type("Assertion failure : "),
+              m_error_code(AssertionFailure)
         {
         }
 
         const char* what() const noexcept override
         {
+            if (m_what.empty())
+            {
+                try
+                {
+                    m_what = FormatError(m_file, m_line, m_error_code) + m_failure_type + m_msg;
+                }
+                catch (...)
+                {
+                    return m_msg.c_str();
+                }
+            }
             return m_what.c_str();
         }
 
         // get the failure message WITHOUT the file and line number bit
-        std::string msg() const
+        const std::string& msg() const
         {
             return m_msg;
         }
 
     private:
-        std::string m_what;
-        std::string m_msg;
+        std::string         m_msg;
+        const char*         m_file = nullptr;
+        int                 m_line;
+        const char*         m_failure_type = nullptr;
+        int                 m_error_code;
+        mutable std::string m_what;
     };
 
     class TestTimeout : public TestFailure
     {
     public:
-        TestTimeout(std::string msg, std::string file, int line)
-            : TestFailure(std::move(msg), std::move(file), line, "Test timeout : ", TimeoutFailure)
+        TestTimeout(std::string msg, const std::string& file, int line)
+            : TestFailure(std::move(msg), file, line, "Test timeout : ", TimeoutFailure)
+        {
+        }
+    };
+
+    class TestLeak : public TestFailure
+    {
+    public:
+        TestLeak(std::string msg, const std::string& file, int line)
+            : TestFailure(std::move(msg), file, line, "Memory leak : ", LeakFailure)
         {
         }
     };
@@ -1,9 +1,58 @@
+#include "resultslog.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
 #include <ctime>
+#include <deque>
 #include <fstream>
+#include <functional>
+#include <iomanip>
+#include <initializer_list>
 #include <iostream>
 #include <map>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <numeric>
+#include <random>
 #include <sstream>
+#include <stdexcept>
 #include <string>
+#include <thread>
+#include <unordered_map>
+
+#if defined(__unix__) || defined(__APPLE__)
+#define TESTFRAMEWORK_HAS_FORK
+#include <cerrno>
+#include <csignal>
+#include <poll.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+
+#if defined(_WIN32)
+#if !defined(WIN32_LEAN_AND_MEAN)
+#define WIN32_LEAN_AND_MEAN
+#endif
+#if !defined(NOMINMAX)
+#define NOMINMAX
+#endif
+#include <windows.h>
+#endif
+
+#if defined(__linux__)
+#define TESTFRAMEWORK_HAS_PERF_EVENTS
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#endif
 
 namespace UnitTests
 {
@@ -32,6 +81,9 @@ namespace UnitTests
             Test
         };
 
+        // the run is about to start, with `tests` tests to run
+        virtual void start_run(size_t tests) = 0;
+
         virtual void start_test(std::string suite, std::string test, std::string base) = 0;
 
         virtual void add_failure(std::string msg) = 0;
@@ -40,6 +92,14 @@ namespace UnitTests
 
         virtual void add_skipped() = 0;
 
+        // a measurement of the current test, e.g. its hardware counters with --perf-counters
+        virtual void add_property(std::string name, std::string value) = 0;
+
+        // how long the current test took by the clock on the wall and in CPU time on its thread, and on the wall the
+        // last time it was run (negative if that is not known)
+        virtual void add_times(
+            std::chrono::nanoseconds wall, std::chrono::nanoseconds cpu, std::chrono::nanoseconds previous) = 0;
+
         virtual void end_test() = 0;
 
         virtual int report() = 0;
@@ -47,15 +107,42 @@ namespace UnitTests
         virtual ~Reporter() = default;
     };
 
+    // a duration in milliseconds to the nearest microsecond
+    inline std::string Milliseconds(std::chrono::nanoseconds duration)
+    {
+        auto s = std::ostringstream{};
+        s << std::fixed << std::setprecision(3) << std::chrono::duration<double, std::milli>(duration).count();
+        return s.str();
+    }
+
+    // a duration in seconds, as JUnit XML has them
+    inline std::string Seconds(std::chrono::nanoseconds duration)
+    {
+        auto s = std::ostringstream{};
+        s << std::fixed << std::setprecision(6) << std::chrono::duration<double>(duration).count();
+        return s.str();
+    }
+
+    // Holds the test being reported, and counts the tests by their result. Nothing is kept of a test once it has
+    // ended, a reporter that needs more keeps it itself.
     class ReporterCommon : public Reporter
     {
     public:
+        void start_run(size_t) override
+        {
+        }
+
         void start_test(std::string suite, std::string test, std::string base_name) override
         {
             m_current_suite = std::move(suite);
             m_current_test  = std::move(test);
             m_current_base  = std::move(base_name);
             m_error         = Passed;
+            m_wall_time     = std::chrono::nanoseconds{0};
+            m_cpu_time      = std::chrono::nanoseconds{0};
+            m_previous_time = std::chrono::nanoseconds{-1};
+            m_msg.clear();
+            m_properties.clear();
         }
 
         void add_failure(std::string msg) override
@@ -75,77 +162,124 @@ namespace UnitTests
             m_error = Skipped;
         }
 
+        void add_property(std::string name, std::string value) override
+        {
+            m_properties.emplace_back(std::move(name), std::move(value));
+        }
+
+        void add_times(
+            std::chrono::nanoseconds wall, std::chrono::nanoseconds cpu, std::chrono::nanoseconds previous) override
+        {
+            m_wall_time     = wall;
+            m_cpu_time      = cpu;
+            m_previous_time = previous;
+        }
+
+        void end_test() override
+        {
+            ++m_counts[m_error];
+            ++m_counts[Test];
+        }
+
+        const std::string& get_suite() const
+        {
+            return m_current_suite;
+        }
+
+        const std::string& get_base_name() const
+        {
+            return m_current_base;
+        }
+
         int get_error() const
         {
             return m_error;
         }
 
-        void end_test() override
+        const std::string& get_message() const
         {
-            m_results[m_current_suite].emplace_back(m_current_test, m_current_base, get_error(), m_msg);
+            return m_msg;
         }
 
-        struct results
+        std::chrono::nanoseconds get_wall_time() const
         {
-            std::string name;
-            std::string base_name;
-            int         error;
-            std::string msg;
+            return m_wall_time;
+        }
 
-            results(std::string n, std::string b, int e, std::string m)
-                : name(std::move(n)), base_name(std::move(b)), error(e), msg(std::move(m))
-            {
-            }
-        };
+        std::chrono::nanoseconds get_cpu_time() const
+        {
+            return m_cpu_time;
+        }
 
-        int count_tests(const std::vector<results>& tests, int error_type)
+        using properties = std::vector<std::pair<std::string, std::string>>;
+
+        const properties& get_properties() const
         {
-            return static_cast<int>(std::count_if(begin(tests), end(tests),
-                [error_type](const results& result) { return error_type == Test || result.error == error_type; }));
+            return m_properties;
         }
 
-        int count_tests(int error_type)
+        struct results
         {
-            auto num_tests = 0;
-            for (auto& suite : m_results)
+            std::string              name;
+            std::string              base_name;
+            int                      error;
+            std::string              msg;
+            properties               props;
+            std::chrono::nanoseconds wall_time;
+            std::chrono::nanoseconds cpu_time;
+            std::chrono::nanoseconds previous_time;
+
+            results(std::string n, std::string b, int e, std::string m, properties p, std::chrono::nanoseconds wall,
+                std::chrono::nanoseconds cpu, std::chrono::nanoseconds previous)
+                : name(std::move(n)), base_name(std::move(b)), error(e), msg(std::move(m)), props(std::move(p)),
+                  wall_time(wall), cpu_time(cpu), previous_time(previous)
             {
-                auto tests = suite.second;
-                num_tests += count_tests(tests, error_type);
             }
-            return num_tests;
+        };
+
+        // a copy of the results of the current test, to keep
+        results get_results() const
+        {
+            return results(m_current_test, m_current_base, m_error, m_msg, m_properties, m_wall_time, m_cpu_time,
+                m_previous_time);
         }
 
-    protected:
-        const std::map<std::string, std::vector<results>>& get_results() const
+        // the number of tests that ended with error_type, or of all of them for Test
+        int count_tests(int error_type) const
         {
-            return m_results;
+            return m_counts[error_type];
         }
 
     private:
-        std::string m_current_suite;
-        std::string m_current_test;
-        std::string m_current_base;
-        std::string m_msg;
-        int         m_error = Passed;
-
-        std::map<std::string, std::vector<results>> m_results;
+        std::string              m_current_suite;
+        std::string              m_current_test;
+        std::string              m_current_base;
+        std::string              m_msg;
+        int                      m_error = Passed;
+        properties               m_properties;
+        std::chrono::nanoseconds m_wall_time{0};
+        std::chrono::nanoseconds m_cpu_time{0};
+        std::chrono::nanoseconds m_previous_time{-1};
+        int                      m_counts[Test + 1] = {};
     };
 
     class StreamReporter : public ReporterCommon
     {
     public:
         using super = ReporterCommon;
-        StreamReporter(std::ostream& os, bool verbose) : m_os(os), m_verbose(verbose)
+        // `slowest` is the number of the slowest tests to list in the report, if it is 0 there is no time breakdown
+        StreamReporter(std::ostream& os, bool verbose, size_t slowest = 0)
+            : m_os(os), m_verbose(verbose), m_slowest(slowest)
         {
         }
 
         void start_test(std::string suite, std::string test, std::string base) override
         {
-            super::start_test(std::move(suite), std::move(test), std::move(base));
             if (m_verbose)
             {
                 print(m_os, "Running ", test, " ");
             }
+            super::start_test(std::move(suite), std::move(test), std::move(base));
         }
 
         void end_test() override
@@ -153,18 +287,38 @@ namespace UnitTests
             switch (get_error())
             {
                 case Passed:
-                    print(m_os, m_verbose ? "OK\n" : ".");
+                    print(m_os, m_verbose ? "OK" : ".");
                     break;
                 case Failed:
-                    print(m_os, m_verbose ? "FAIL\n" : "F");
+                    print(m_os, m_verbose ? "FAIL" : "F");
                     break;
                 case Skipped:
-                    print(m_os, m_verbose ? "SKIP\n" : "S");
+                    print(m_os, m_verbose ? "SKIP" : "S");
                     break;
                 case Error:
-                    print(m_os, m_verbose ? "ERROR\n" : "E");
+                    print(m_os, m_verbose ? "ERROR" : "E");
                     break;
             }
+            if (m_verbose)
+            {
+                print(m_os, " (", Milliseconds(get_wall_time()), "ms, cpu ", Milliseconds(get_cpu_time()), "ms)");
+                for (auto& property : get_properties())
+                {
+                    print(m_os, " ", property.first, "=", property.second);
+                }
+                print(m_os, "\n");
+            }
+
+            // only what the report shows is kept, so a run of many tests that pass takes no more memory than a few
+            if (get_error() != Passed)
+            {
+                m_unsuccessful[get_suite()].push_back(get_results());
+            }
+            if (m_slowest != 0)
+            {
+                keep_if_slow();
+                m_suite_times[get_suite()] += get_wall_time();
+            }
             super::end_test();
         }
 
@@ -174,6 +328,8 @@ namespace UnitTests
             auto errors   = show_results(Error, "Errors");
             auto failures = show_results(Failed, "Failures");
             auto skipped  = show_results(Skipped, "Skipped");
+            if (m_slowest != 0)
+                show_times();
 
             print(m_os, count_tests(Test), " Tests.\n");
             print(m_os, skipped, " Skipped.\n");
@@ -189,10 +345,9 @@ namespace UnitTests
             if (num_errors)
             {
                 print(m_os, msg, " :-\n");
-                for (auto& suite : get_results())
+                for (auto& suite : m_unsuccessful)
                 {
-                    auto tests = suite.second;
-                    for (auto& result : tests)
+                    for (auto& result : suite.second)
                     {
                         if (result.error == error_type)
                         {
@@ -207,209 +362,2905 @@ namespace UnitTests
             return num_errors;
         }
 
+        // the slowest tests, with the change since the last run, and the time taken by each suite
+        void show_times()
+        {
+            std::sort_heap(begin(m_slowest_tests), end(m_slowest_tests), slower);
+            print(m_os, "Slowest ", m_slowest_tests.size(), " Tests :-\n");
+            for (auto& test : m_slowest_tests)
+            {
+                auto& result = test.second;
+                m_os << std::setw(14) << Milliseconds(result.wall_time) << "ms  " << test.first << '.'
+                     << result.base_name << ' ' << Change(result.wall_time, result.previous_time) << '\n';
+            }
+
+            using timed_suite = std::pair<std::string, std::chrono::nanoseconds>;
+            auto suites       = std::vector<timed_suite>(begin(m_suite_times), end(m_suite_times));
+            std::sort(begin(suites), end(suites), [](const timed_suite& lhs, const timed_suite& rhs) {
+                return lhs.second > rhs.second;
+            });
+            print(m_os, "Time by suite :-\n");
+            for (auto& suite : suites)
+            {
+                m_os << std::setw(14) << Milliseconds(suite.second) << "ms  " << suite.first << '\n';
+            }
+        }
+
+        // e.g. "(+12.5% from 3.200ms)", or "(new)" if the test was not timed before
+        static std::string Change(std::chrono::nanoseconds wall, std::chrono::nanoseconds previous)
+        {
+            if (previous.count() < 0)
+                return "(new)";
+
+            auto ratio = previous.count() == 0 ? 1.0 : static_cast<double>(wall.count()) / previous.count();
+            auto s     = std::ostringstream{};
+            s << '(' << std::showpos << std::fixed << std::setprecision(1) << 100.0 * (ratio - 1.0) << std::noshowpos
+              << "% from " << Milliseconds(previous) << "ms)";
+            return s.str();
+        }
+
     private:
+        using timed_test = std::pair<std::string, results>;
+
+        static bool slower(const timed_test& lhs, const timed_test& rhs)
+        {
+            return lhs.second.wall_time > rhs.second.wall_time;
+        }
+
+        // m_slowest_tests is a heap with the fastest of the slowest tests at the front
+        void keep_if_slow()
+        {
+            if (m_slowest_tests.size() == m_slowest)
+            {
+                if (get_wall_time() <= m_slowest_tests.front().second.wall_time)
+                    return;
+                std::pop_heap(begin(m_slowest_tests), end(m_slowest_tests), slower);
+                m_slowest_tests.pop_back();
+            }
+            m_slowest_tests.emplace_back(get_suite(), get_results());
+            std::push_heap(begin(m_slowest_tests), end(m_slowest_tests), slower);
+        }
+
         std::ostream& m_os;
         bool          m_verbose;
+        size_t        m_slowest;
+
+        std::map<std::string, std::vector<results>>     m_unsuccessful;
+        std::vector<timed_test>                         m_slowest_tests;
+        std::map<std::string, std::chrono::nanoseconds> m_suite_times;
     };
 
+    // Writes JUnit XML as the tests end, so it takes the same memory however many tests there are. A test from a
+    // different suite than the one before starts a new <testsuite>, the totals of which are written into the space left
+    // for them in its start tag once it is complete.
     class XMLReporter : public ReporterCommon
     {
     public:
         using super = ReporterCommon;
-        XMLReporter(const std::string& filename) : m_filename(filename)
+        XMLReporter(const std::string& filename) : m_file(filename)
         {
+            m_file << "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n";
+            m_file << "<testsuites>\n";
         }
 
-        void write_testcase(
-            std::ostream& s, const results& result, const std::string& classname, const std::string& indent)
+        void end_test() override
         {
-            if (result.error == Passed)
+            if (!m_in_suite || get_suite() != m_suite)
             {
-                s << indent << "<testcase classname=\"" << classname << "\" name=\"" << result.base_name << "\" />\n";
+                end_suite();
+                start_suite();
             }
-            else
+            write_testcase();
+
+            ++m_suite_counts[get_error()];
+            ++m_suite_counts[Test];
+            m_suite_time += get_wall_time();
+            super::end_test();
+        }
+
+        int report() override
+        {
+            end_suite();
+            m_file << "</testsuites>\n";
+            m_file.flush();
+
+            return count_tests(Error) + count_tests(Failed);
+        }
+
+    private:
+        // room for ` tests="N" failures="N" errors="N" skipped="N" time="S"` with the largest values they can have
+        static constexpr size_t totals_width = 128;
+
+        void start_suite()
+        {
+            m_suite = get_suite();
+            m_file << "  <testsuite id=\"" << m_id++ << "\" name=\"" << XmlEscaped(m_suite, true) << '"';
+            m_totals = m_file.tellp();
+            m_file << std::string(totals_width, ' ') << ">\n";
+
+            m_in_suite   = true;
+            m_suite_time = std::chrono::nanoseconds{0};
+            std::fill(std::begin(m_suite_counts), std::end(m_suite_counts), 0);
+        }
+
+        void end_suite()
+        {
+            if (!m_in_suite)
+                return;
+
+            m_file << "  </testsuite>\n";
+            m_in_suite = false;
+
+            // without a file to seek in, e.g. writing to a pipe, the suite goes without its totals
+            auto end = m_file.tellp();
+            if (m_totals == std::streampos(-1) || end == std::streampos(-1))
+                return;
+
+            m_file.seekp(m_totals);
+            m_file << " tests=\"" << m_suite_counts[Test] << "\" failures=\"" << m_suite_counts[Failed]
+                   << "\" errors=\"" << m_suite_counts[Error] << "\" skipped=\"" << m_suite_counts[Skipped]
+                   << "\" time=\"" << Seconds(m_suite_time) << "\"";
+            m_file.seekp(end);
+        }
+
+        void write_testcase()
+        {
+            m_file << "    <testcase classname=\"" << XmlEscaped(m_suite, true) << "\" name=\""
+                   << XmlEscaped(get_base_name(), true) << "\" time=\"" << Seconds(get_wall_time()) << "\"";
+            if (get_error() == Passed && get_properties().empty())
             {
-                s << indent << "<testcase classname=\"" << classname << "\" name=\"" << result.base_name << "\">\n";
-                auto new_indent = indent + "  ";
-                if (result.error == Skipped)
-                {
-                    s << new_indent << "<skipped message=\"" << result.msg << "\"/>\n";
-                }
-                else if (result.error == Failed)
-                {
-                    s << new_indent << "<Failure message=\"Test Failure\">\n";
-                    s << result.msg << "\n";
-                    s << new_indent << "</Failure>\n";
-                }
-                else if (result.error == Error)
+                m_file << " />\n";
+                return;
+            }
+
+            m_file << ">\n";
+            if (!get_properties().empty())
+            {
+                m_file << "      <properties>\n";
+                for (auto& property : get_properties())
                 {
-                    s << new_indent << "<Error message=\"Unexpected Exception encountered\">\n";
-                    s << result.msg << "\n";
-                    s << new_indent << "</Error>\n";
+                    m_file << "        <property name=\"" << XmlEscaped(property.first, true) << "\" value=\""
+                           << XmlEscaped(property.second, true) << "\"/>\n";
                 }
-                s << indent << "</testcase>\n";
+                m_file << "      </properties>\n";
+            }
+            if (get_error() == Skipped)
+            {
+                m_file << "      <skipped message=\"" << XmlEscaped(get_message(), true) << "\"/>\n";
+            }
+            else if (get_error() == Failed)
+            {
+                m_file << "      <Failure message=\"Test Failure\">\n";
+                m_file << XmlEscaped(get_message()) << "\n";
+                m_file << "      </Failure>\n";
+            }
+            else if (get_error() == Error)
+            {
+                m_file << "      <Error message=\"Unexpected Exception encountered\">\n";
+                m_file << XmlEscaped(get_message()) << "\n";
+                m_file << "      </Error>\n";
             }
+            m_file << "    </testcase>\n";
+        }
+
+        std::ofstream            m_file;
+        bool                     m_in_suite = false;
+        std::string              m_suite;
+        int                      m_id = 0;
+        std::streampos           m_totals;
+        int                      m_suite_counts[Test + 1] = {};
+        std::chrono::nanoseconds m_suite_time{0};
+    };
+
+    // Writes an event as a line of JSON when the run starts, as each test starts and ends, and when the run ends, for
+    // tools that follow a run as it goes e.g.
+    //
+    //  {"event": "run_start", "tests": 2}
+    //  {"event": "test_start", "suite": "parser", "name": "empty"}
+    //  {"event": "test_end", "suite": "parser", "name": "empty", "status": "passed", "wall_ns": 1200, "cpu_ns": 1100}
+    //  ...
+    //  {"event": "run_end", "tests": 2, "skipped": 0, "failures": 1, "errors": 0}
+    //
+    // A test_end has a "message" unless the test passed, and "properties" if it has any. The lines are written in
+    // batches, a batch goes once it has batch_lines lines or a test ends batch_time after the last one went.
+    class JsonLinesReporter : public ReporterCommon
+    {
+    public:
+        using super = ReporterCommon;
+
+        static constexpr size_t                    batch_lines = 256;
+        static constexpr std::chrono::milliseconds batch_time{100};
+
+        // writes to the file, or to `os` if the filename is "-"
+        JsonLinesReporter(const std::string& filename, std::ostream& os)
+            : m_os(filename == "-" ? os : m_file), m_last_flush(std::chrono::steady_clock::now())
+        {
+            if (filename != "-")
+                m_file.open(filename);
         }
 
-        void write_suite(std::ostream& s, const std::string& name, const std::vector<results>& results,
-            const std::string& indent, int id)
+        void start_run(size_t tests) override
         {
-            auto tests    = count_tests(results, Test);
-            auto failures = count_tests(results, Failed);
-            auto errors   = count_tests(results, Error);
-            auto skipped  = count_tests(results, Skipped);
+            m_batch << "{\"event\": \"run_start\", \"tests\": " << tests << "}\n";
+            ++m_lines;
+            flush(false);
+        }
 
-            s << indent << "<testsuite id=\"" << id << "\" name=\"" << name << "\" tests=\"" << tests
-              << "\" failures=\"" << failures << "\" errors=\"" << errors << "\" skipped=\"" << skipped << "\">\n";
+        void start_test(std::string suite, std::string test, std::string base) override
+        {
+            super::start_test(std::move(suite), std::move(test), std::move(base));
+            m_batch << "{\"event\": \"test_start\", \"suite\": \"" << JsonEscaped(get_suite()) << "\", \"name\": \""
+                    << JsonEscaped(get_base_name()) << "\"}\n";
+            ++m_lines;
+        }
 
-            for (auto& result : results)
+        void end_test() override
+        {
+            auto status = results_log::StatusName(static_cast<uint32_t>(get_error()));
+            m_batch << "{\"event\": \"test_end\", \"suite\": \"" << JsonEscaped(get_suite()) << "\", \"name\": \""
+                    << JsonEscaped(get_base_name()) << "\", \"status\": \"" << status << "\", \"wall_ns\": "
+                    << get_wall_time().count() << ", \"cpu_ns\": " << get_cpu_time().count();
+            if (get_error() != Passed)
+                m_batch << ", \"message\": \"" << JsonEscaped(get_message()) << '"';
+            if (!get_properties().empty())
             {
-                write_testcase(s, result, name, indent + "  ");
+                auto separator = "";
+                m_batch << ", \"properties\": {";
+                for (auto& property : get_properties())
+                {
+                    m_batch << separator << '"' << JsonEscaped(property.first) << "\": \""
+                            << JsonEscaped(property.second) << '"';
+                    separator = ", ";
+                }
+                m_batch << '}';
             }
-
-            s << indent << "</testsuite>\n";
+            m_batch << "}\n";
+            ++m_lines;
+            super::end_test();
+            flush(false);
         }
 
         int report() override
         {
-            auto f = std::ofstream(m_filename);
-            f << "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n";
-            f << "<testsuites>\n";
+            m_batch << "{\"event\": \"run_end\", \"tests\": " << count_tests(Test) << ", \"skipped\": "
+                    << count_tests(Skipped) << ", \"failures\": " << count_tests(Failed)
+                    << ", \"errors\": " << count_tests(Error) << "}\n";
+            flush(true);
+            return count_tests(Error) + count_tests(Failed);
+        }
+
+    private:
+        void flush(bool always)
+        {
+            auto now = std::chrono::steady_clock::now();
+            if (!always && m_lines < batch_lines && now - m_last_flush < batch_time)
+                return;
+
+            m_os << m_batch.str() << std::flush;
+            m_batch.str(std::string{});
+            m_lines      = 0;
+            m_last_flush = now;
+        }
+
+        std::ofstream                         m_file;
+        std::ostream&                         m_os;
+        std::ostringstream                    m_batch;
+        size_t                                m_lines = 0;
+        std::chrono::steady_clock::time_point m_last_flush;
+    };
+
+    constexpr size_t                    JsonLinesReporter::batch_lines;
+    constexpr std::chrono::milliseconds JsonLinesReporter::batch_time;
+
+#if defined(TESTFRAMEWORK_HAS_MMAP)
+    // Adds a record for each test to a results log (see resultslog.h), for runs with too many tests to write out as
+    // text or XML.
+    class BinaryReporter : public ReporterCommon
+    {
+    public:
+        using super = ReporterCommon;
+        BinaryReporter(const std::string& filename) : m_log(filename)
+        {
+        }
 
-            int id = 0;
-            for (auto& result : get_results())
+        void end_test() override
+        {
+            // the tests of a suite mostly end one after another, so its name is only written once for each of those
+            if (m_suite_string == results_log::no_string || get_suite() != m_suite)
             {
-                write_suite(f, result.first, result.second, "  ", id++);
+                m_suite        = get_suite();
+                m_suite_hash   = results_log::SuiteHash(m_suite);
+                m_suite_string = m_log.add_string(m_suite);
             }
-            f << "</testsuites>\n";
 
+            auto record       = results_log::Record{};
+            record.suite_hash = m_suite_hash;
+            record.test_hash  = results_log::TestHash(m_suite, get_base_name());
+            record.wall_time  = get_wall_time().count();
+            record.cpu_time   = get_cpu_time().count();
+            record.suite      = m_suite_string;
+            record.name       = m_log.add_string(get_base_name());
+            record.message    = get_message().empty() ? results_log::no_string : m_log.add_string(get_message());
+            record.status     = static_cast<uint32_t>(get_error());
+            m_log.add(record);
+            super::end_test();
+        }
+
+        int report() override
+        {
+            m_log.close();
             return count_tests(Error) + count_tests(Failed);
         }
 
     private:
-        std::string m_filename;
+        ResultsLogWriter m_log;
+        std::string      m_suite;
+        uint64_t         m_suite_hash   = 0;
+        uint64_t         m_suite_string = results_log::no_string;
     };
+#endif
 
-    std::string MiniSuite::Test::BareName(const std::string& indexs) const
+    // A bounded queue with one thread putting items on and one taking them off, that needs no lock. The putting end
+    // can pass from thread to thread as long as something else orders the hand overs, as the mutex the runners report
+    // under does.
+    template <class T>
+    class SpscQueue
     {
-        return m_name + indexs;
-    }
+    public:
+        explicit SpscQueue(size_t capacity) : m_slots(capacity + 1)
+        {
+        }
 
-    std::string MiniSuite::Test::Name(const std::string& indexs) const
-    {
-        std::stringstream s;
-        s << BareName(indexs) << " @ " << m_file << ':' << m_line;
-        return s.str();
-    }
-    std::string MiniSuite::Test::Suite() const
-    {
-        return m_suite;
-    }
+        bool try_push(T& item)
+        {
+            auto tail = m_tail.load(std::memory_order_relaxed);
+            auto next = tail + 1 == m_slots.size() ? 0 : tail + 1;
+            if (next == m_head.load(std::memory_order_acquire))
+                return false;
+            m_slots[tail] = std::move(item);
+            m_tail.store(next, std::memory_order_release);
+            return true;
+        }
 
-    size_t MiniSuite::AddTest(std::unique_ptr<Test> test)
-    {
-        tests.push_back(std::move(test));
-        return 0;
-    }
+        bool try_pop(T& item)
+        {
+            auto head = m_head.load(std::memory_order_relaxed);
+            if (head == m_tail.load(std::memory_order_acquire))
+                return false;
+            item = std::move(m_slots[head]);
+            m_head.store(head + 1 == m_slots.size() ? 0 : head + 1, std::memory_order_release);
+            return true;
+        }
 
-    bool MiniSuite::IsVerbose(const std::vector<std::string>& args)
-    {
-        return std::any_of(begin(args), end(args), [](const auto& s) { return s == "-v" || s == "--verbose"; });
-    }
+    private:
+        std::vector<T> m_slots;
+        // the ends are a cache line apart so the two threads don't fight over one
+        std::atomic<size_t> m_head{0};
+        char                m_padding[64];
+        std::atomic<size_t> m_tail{0};
+    };
 
-    void MiniSuite::show_failures(
-        std::ostream& os, const std::vector<std::pair<std::string, std::string>> failures, const std::string& type)
+    // Hands everything reported on to several reporters, from a thread of its own so a slow terminal or disk does not
+    // hold up the tests. All that reporting a test costs the thread that ran it is putting it on a queue, which blocks
+    // only while the queue is full. Without the thread (`threaded` false) the reporters are called as each test ends.
+    class FanOutReporter : public Reporter
     {
-        if (!failures.empty())
+    public:
+        static constexpr size_t queue_size = 1024;
+
+        FanOutReporter(std::vector<std::unique_ptr<Reporter>> reporters, bool threaded)
+            : m_reporters(std::move(reporters)), m_queue(queue_size)
         {
-            print(os, type, " :-\n");
-            std::for_each(begin(failures), end(failures),
-                [&](auto f) { print(os, f.second, " while testing TEST(", f.first, ")\n"); });
+            if (threaded)
+                m_thread = std::thread([this] { dispatch(); });
         }
-    }
 
-    std::string FindXMLFilename(const std::vector<std::string>& args)
-    {
-        auto pos = std::find_if(begin(args), end(args), [](const std::string& s) { return s == "--xml" || s == "-x"; });
-        if (pos != end(args))
+        FanOutReporter(const FanOutReporter&) = delete;
+        FanOutReporter& operator=(const FanOutReporter&) = delete;
+
+        ~FanOutReporter() override
         {
-            pos = std::next(pos);
-            if (pos != end(args))
-                return *pos;
-            else
-            {
-                throw std::runtime_error("You must provide a filename for the xml report.");
-            }
+            stop();
         }
 
-        return "";
-    }
-
-    int MiniSuite::RunTests(const std::vector<std::string>& args, std::ostream& os)
-    {
-        auto verbose    = IsVerbose(args);
-        auto start_time = clock();
+        void start_run(size_t tests) override
+        {
+            auto event  = Event{};
+            event.kind  = Event::StartRun;
+            event.tests = tests;
+            post(event);
+        }
 
-        auto xml      = FindXMLFilename(args);
-        auto reporter = xml.empty() ? std::unique_ptr<Reporter>(std::make_unique<StreamReporter>(os, verbose)) :
-                                      std::unique_ptr<Reporter>(std::make_unique<XMLReporter>(xml));
+        void start_test(std::string suite, std::string test, std::string base) override
+        {
+            m_test       = Event{};
+            m_test.suite = std::move(suite);
+            m_test.test  = std::move(test);
+            m_test.base  = std::move(base);
+        }
 
-        run_tests(tests, *reporter);
-        auto end_time = clock();
-        auto failures = reporter->report();
-        print(os, "\nTime taken = ", 1000.0 * (end_time - start_time) / CLOCKS_PER_SEC, "ms\n");
-        return failures;
-    }
+        void add_failure(std::string msg) override
+        {
+            m_test.error = Failed;
+            m_test.msg   = std::move(msg);
+        }
 
-    int MiniSuite::run_tests(std::vector<std::unique_ptr<Test>>& all_tests, Reporter& reporter)
-    {
-        auto num_tests = 0U;
-        for (auto& test : all_tests)
+        void add_error(std::string msg) override
         {
-            for (auto index = 0; index != test->NumTests(); ++index)
-            {
-                auto indexs = std::string(test->NumTests() == 1 ? "" : "[" + std::to_string(index) + "]");
-                reporter.start_test(test->Suite(), test->Name(indexs), test->BareName(indexs));
-                try
-                {
-                    test->Run(index);
-                }
-                catch (TestFailure& e)
-                {
-                    reporter.add_failure(e.what());
-                }
-                catch (const std::exception& e)
-                {
-                    reporter.add_error(e.what());
-                }
-                reporter.end_test();
-            }
+            m_test.error = Error;
+            m_test.msg   = std::move(msg);
         }
-        return num_tests;
-    }
 
-    MiniSuite& MiniSuite::Instance()
-    {
-        static UnitTests::MiniSuite runner;
-        return runner;
-    }
+        void add_skipped() override
+        {
+            m_test.error = Skipped;
+        }
 
-    std::string FormatError(std::string file, int line, int error)
-    {
-        auto msg(std::move(file));
-        msg += "(" + std::to_string(line) + ")";
-        msg += " : error A" + std::to_string(error) + ": ";
-        return msg;
-    }
-} // namespace UnitTests
+        void add_property(std::string name, std::string value) override
+        {
+            m_test.properties.emplace_back(std::move(name), std::move(value));
+        }
 
+        void add_times(
+            std::chrono::nanoseconds wall, std::chrono::nanoseconds cpu, std::chrono::nanoseconds previous) override
+        {
+            m_test.wall     = wall;
+            m_test.cpu      = cpu;
+            m_test.previous = previous;
+        }
+
+        void end_test() override
+        {
+            post(m_test);
+        }
+
+        // the reports are made once everything reported so far has been handed on, they all count the same failures
+        int report() override
+        {
+            stop();
+            if (m_exception)
+                std::rethrow_exception(m_exception);
+
+            auto failures = 0;
+            for (auto& reporter : m_reporters)
+                failures = reporter->report();
+            return failures;
+        }
+
+    private:
+        // a call to start_run, or all the calls for a test
+        struct Event
+        {
+            enum Kind
+            {
+                StartRun,
+                Test,
+                Stop
+            };
+
+            Kind                                             kind  = Test;
+            size_t                                           tests = 0;
+            std::string                                      suite;
+            std::string                                      test;
+            std::string                                      base;
+            int                                              error = Passed;
+            std::string                                      msg;
+            std::vector<std::pair<std::string, std::string>> properties;
+            std::chrono::nanoseconds                         wall{0};
+            std::chrono::nanoseconds                         cpu{0};
+            std::chrono::nanoseconds                         previous{-1};
+        };
+
+        void post(Event& event)
+        {
+            if (!m_thread.joinable())
+            {
+                hand_on(event);
+                return;
+            }
+            while (!m_queue.try_push(event))
+                std::this_thread::yield();
+        }
+
+        void stop()
+        {
+            if (!m_thread.joinable())
+                return;
+
+            auto event = Event{};
+            event.kind = Event::Stop;
+            post(event);
+            m_thread.join();
+        }
+
+        // runs on the thread, it spins a little when the queue is empty before it sleeps
+        void dispatch()
+        {
+            auto event = Event{};
+            for (auto idle = 0;; ++idle)
+            {
+                if (!m_queue.try_pop(event))
+                {
+                    if (idle < 64)
+                        std::this_thread::yield();
+                    else
+                        std::this_thread::sleep_for(std::chrono::microseconds(200));
+                    continue;
+                }
+                if (event.kind == Event::Stop)
+                    return;
+                hand_on(event);
+                idle = 0;
+            }
+        }
+
+        void hand_on(const Event& event)
+        {
+            // once a reporter has failed the rest of the events are dropped, report() throws what it threw
+            if (m_exception)
+                return;
+
+            try
+            {
+                for (auto& reporter : m_reporters)
+                {
+                    if (event.kind == Event::StartRun)
+                    {
+                        reporter->start_run(event.tests);
+                        continue;
+                    }
+
+                    reporter->start_test(event.suite, event.test, event.base);
+                    for (auto& property : event.properties)
+                        reporter->add_property(property.first, property.second);
+                    if (event.error == Failed)
+                        reporter->add_failure(event.msg);
+                    else if (event.error == Error)
+                        reporter->add_error(event.msg);
+                    else if (event.error == Skipped)
+                        reporter->add_skipped();
+                    reporter->add_times(event.wall, event.cpu, event.previous);
+                    reporter->end_test();
+                }
+            }
+            catch (...)
+            {
+                m_exception = std::current_exception();
+            }
+        }
+
+        std::vector<std::unique_ptr<Reporter>> m_reporters;
+        SpscQueue<Event>                       m_queue;
+        Event                                  m_test;
+        std::exception_ptr                     m_exception;
+        std::thread                            m_thread;
+    };
+
+    constexpr size_t FanOutReporter::queue_size;
+
+    std::string MiniSuite::Node::BareName(const std::string& indexs) const
+    {
+        return m_name + indexs;
+    }
+
+    std::string MiniSuite::Node::Name(const std::string& indexs) const
+    {
+        std::stringstream s;
+        s << BareName(indexs) << " @ " << m_file << ':' << m_line;
+        return s.str();
+    }
+
+    size_t MiniSuite::AddTest(std::unique_ptr<Test> test)
+    {
+        AddTest(test->m_node);
+        tests.push_back(std::move(test));
+        return 0;
+    }
+
+    size_t MiniSuite::AddTest(Node& node)
+    {
+        if (m_last != nullptr)
+            m_last->m_next = &node;
+        else
+            m_first = &node;
+        m_last = &node;
+        return 0;
+    }
+
+    size_t MiniSuite::AddBenchmark(Benchmark& benchmark)
+    {
+        if (m_last_benchmark != nullptr)
+            m_last_benchmark->m_next = &benchmark;
+        else
+            m_first_benchmark = &benchmark;
+        m_last_benchmark = &benchmark;
+        return 0;
+    }
+
+    bool MiniSuite::IsVerbose(const std::vector<std::string>& args)
+    {
+        return std::any_of(begin(args), end(args), [](const auto& s) { return s == "-v" || s == "--verbose"; });
+    }
+
+    void MiniSuite::show_failures(
+        std::ostream& os, const std::vector<std::pair<std::string, std::string>> failures, const std::string& type)
+    {
+        if (!failures.empty())
+        {
+            print(os, type, " :-\n");
+            std::for_each(begin(failures), end(failures),
+                [&](auto f) { print(os, f.second, " while testing TEST(", f.first, ")\n"); });
+        }
+    }
+
+    // Returns the argument following the first of `names` found in args, or an empty string if none of them are
+    // present. `what` describes the missing argument in the error raised when the option is the last one given.
+    std::string FindOption(
+        const std::vector<std::string>& args, std::initializer_list<const char*> names, const std::string& what)
+    {
+        auto pos = std::find_if(begin(args), end(args),
+            [&](const std::string& s) { return std::find(begin(names), end(names), s) != end(names); });
+        if (pos != end(args))
+        {
+            pos = std::next(pos);
+            if (pos != end(args))
+                return *pos;
+            else
+            {
+                throw std::runtime_error("You must provide " + what + ".");
+            }
+        }
+
+        return "";
+    }
+
+    std::string FindXMLFilename(const std::vector<std::string>& args)
+    {
+        return FindOption(args, {"--xml", "-x"}, "a filename for the xml report");
+    }
+
+    // --jobs N (or -j N) runs the tests on N threads, --jobs 0 uses one thread per hardware thread.
+    unsigned FindJobs(const std::vector<std::string>& args)
+    {
+        auto jobs = FindOption(args, {"--jobs", "-j"}, "a number of jobs");
+        if (jobs.empty())
+            return 1;
+
+        auto n = std::stoi(jobs);
+        if (n < 0)
+            throw std::runtime_error("The number of jobs can not be negative.");
+
+        return n != 0 ? static_cast<unsigned>(n) : std::max(1U, std::thread::hardware_concurrency());
+    }
+
+    // --filter POSITIVE[-NEGATIVE] selects the tests to run in the same way as gtest, each of POSITIVE and NEGATIVE
+    // is a ':' separated list of patterns matched against "suite.name" where '*' matches any string and '?' any single
+    // character. A test is run if it matches any of the positive patterns (or there are none) and none of the
+    // negative ones. The patterns are parsed once, and matched against the suite and name in place.
+    class TestFilter
+    {
+    public:
+        TestFilter() = default;
+
+        explicit TestFilter(const std::string& filter)
+        {
+            auto dash     = filter.find('-');
+            auto positive = filter.substr(0, dash);
+            split(positive, m_positive);
+            if (dash != std::string::npos)
+                split(filter.substr(dash + 1), m_negative);
+        }
+
+        bool matches(const char* suite, const char* name) const
+        {
+            auto qualified = QualifiedName{suite, std::strlen(suite), name, std::strlen(name)};
+            auto match     = [&](const Pattern& pattern) { return pattern.matches(qualified); };
+            return (m_positive.empty() || std::any_of(begin(m_positive), end(m_positive), match)) &&
+                   std::none_of(begin(m_negative), end(m_negative), match);
+        }
+
+        bool empty() const
+        {
+            return m_positive.empty() && m_negative.empty();
+        }
+
+    private:
+        // "suite.name" without building the string
+        struct QualifiedName
+        {
+            const char* suite;
+            size_t      suite_size;
+            const char* name;
+            size_t      name_size;
+
+            size_t size() const
+            {
+                return suite_size + 1 + name_size;
+            }
+
+            char operator[](size_t i) const
+            {
+                return i < suite_size ? suite[i] : i == suite_size ? '.' : name[i - suite_size - 1];
+            }
+        };
+
+        struct Pattern
+        {
+            std::string glob;
+            bool        literal;
+
+            bool matches(const QualifiedName& name) const
+            {
+                if (literal)
+                {
+                    if (glob.size() != name.size())
+                        return false;
+                    for (auto i = size_t{0}; i != glob.size(); ++i)
+                    {
+                        if (glob[i] != name[i])
+                            return false;
+                    }
+                    return true;
+                }
+
+                // on a mismatch go back to the last '*' and let it swallow one more character
+                auto g      = size_t{0};
+                auto n      = size_t{0};
+                auto star   = std::string::npos;
+                auto resume = size_t{0};
+                while (n != name.size())
+                {
+                    if (g != glob.size() && (glob[g] == '?' || glob[g] == name[n]))
+                    {
+                        ++g;
+                        ++n;
+                    }
+                    else if (g != glob.size() && glob[g] == '*')
+                    {
+                        star   = g++;
+                        resume = n;
+                    }
+                    else if (star != std::string::npos)
+                    {
+                        g = star + 1;
+                        n = ++resume;
+                    }
+                    else
+                        return false;
+                }
+                while (g != glob.size() && glob[g] == '*')
+                {
+                    ++g;
+                }
+                return g == glob.size();
+            }
+        };
+
+        static void split(const std::string& patterns, std::vector<Pattern>& out)
+        {
+            auto start = size_t{0};
+            while (start <= patterns.size())
+            {
+                auto end  = std::min(patterns.find(':', start), patterns.size());
+                auto glob = patterns.substr(start, end - start);
+                if (!glob.empty())
+                    out.push_back(Pattern{glob, glob.find_first_of("*?") == std::string::npos});
+                start = end + 1;
+            }
+        }
+
+        std::vector<Pattern> m_positive;
+        std::vector<Pattern> m_negative;
+    };
+
+    // The hardware events counted while a test or benchmark ran.
+    struct PerfCounts
+    {
+        bool     valid         = false;
+        uint64_t cycles        = 0;
+        uint64_t instructions  = 0;
+        uint64_t cache_misses  = 0;
+        uint64_t branch_misses = 0;
+
+        PerfCounts& operator+=(const PerfCounts& other)
+        {
+            valid = valid || other.valid;
+            cycles += other.cycles;
+            instructions += other.instructions;
+            cache_misses += other.cache_misses;
+            branch_misses += other.branch_misses;
+            return *this;
+        }
+
+        double ipc() const
+        {
+            return cycles == 0 ? 0.0 : static_cast<double>(instructions) / static_cast<double>(cycles);
+        }
+    };
+
+    // --perf-counters counts the cycles, instructions, cache misses and branch misses of each test and benchmark with
+    // a group of perf_event_open counters. They count the user space of the thread that opened them, so each thread
+    // running tests opens its own; threads a test starts are not counted. If the kernel will not open them (see
+    // /proc/sys/kernel/perf_event_paranoid), or there is no PMU as in many virtual machines, error() says why.
+    class PerfCounters
+    {
+    public:
+        PerfCounters()
+        {
+#if defined(TESTFRAMEWORK_HAS_PERF_EVENTS)
+            const uint64_t events[] = {PERF_COUNT_HW_CPU_CYCLES, PERF_COUNT_HW_INSTRUCTIONS, PERF_COUNT_HW_CACHE_MISSES,
+                PERF_COUNT_HW_BRANCH_MISSES};
+            for (auto i = size_t{0}; i != num_events; ++i)
+            {
+                auto attr           = perf_event_attr{};
+                attr.size           = sizeof attr;
+                attr.type           = PERF_TYPE_HARDWARE;
+                attr.config         = events[i];
+                attr.disabled       = i == 0 ? 1 : 0; // the group is started and stopped with its leader
+                attr.exclude_kernel = 1;
+                attr.exclude_hv     = 1;
+                attr.read_format = PERF_FORMAT_GROUP | PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+
+                auto fd = syscall(SYS_perf_event_open, &attr, 0, -1, i == 0 ? -1 : m_fds[0], 0UL);
+                if (fd < 0)
+                {
+                    m_error = std::strerror(errno);
+                    close_all();
+                    return;
+                }
+                m_fds[i] = static_cast<int>(fd);
+            }
+#else
+            m_error = "not supported on this platform";
+#endif
+        }
+
+        PerfCounters(const PerfCounters&) = delete;
+        PerfCounters& operator=(const PerfCounters&) = delete;
+
+        ~PerfCounters()
+        {
+            close_all();
+        }
+
+        bool valid() const
+        {
+            return m_fds[0] >= 0;
+        }
+
+        const std::string& error() const
+        {
+            return m_error;
+        }
+
+        void start()
+        {
+#if defined(TESTFRAMEWORK_HAS_PERF_EVENTS)
+            if (valid())
+            {
+                ioctl(m_fds[0], PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+                ioctl(m_fds[0], PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+            }
+#endif
+        }
+
+        // the counts since start(), scaled up if the kernel had to share the PMU with other counters
+        PerfCounts stop()
+        {
+            auto counts = PerfCounts{};
+#if defined(TESTFRAMEWORK_HAS_PERF_EVENTS)
+            if (!valid())
+                return counts;
+
+            ioctl(m_fds[0], PERF_EVENT_IOC_DISABLE, PERF_IOC_FLAG_GROUP);
+            // the number of counters, the time enabled and running, then the counts
+            uint64_t values[3 + num_events] = {};
+            auto     size                   = read(m_fds[0], values, sizeof values);
+            if (size != static_cast<ssize_t>(sizeof values) || values[0] != num_events || values[2] == 0)
+                return counts;
+
+            auto scale = [&](uint64_t count) {
+                return static_cast<uint64_t>(static_cast<double>(count) * values[1] / values[2]);
+            };
+            counts.valid         = true;
+            counts.cycles        = scale(values[3]);
+            counts.instructions  = scale(values[4]);
+            counts.cache_misses  = scale(values[5]);
+            counts.branch_misses = scale(values[6]);
+#endif
+            return counts;
+        }
+
+    private:
+        static constexpr size_t num_events = 4;
+
+        void close_all()
+        {
+#if defined(TESTFRAMEWORK_HAS_PERF_EVENTS)
+            for (auto& fd : m_fds)
+            {
+                if (fd >= 0)
+                    close(fd);
+                fd = -1;
+            }
+#endif
+        }
+
+        int         m_fds[num_events] = {-1, -1, -1, -1};
+        std::string m_error;
+    };
+
+    constexpr size_t PerfCounters::num_events;
+
+    // Checks the counters can be opened before a --perf-counters run, if not the run goes ahead without them.
+    bool CheckPerfCounters(std::ostream& os)
+    {
+        PerfCounters counters;
+        if (!counters.valid())
+            print(os, "Hardware performance counters are not available (", counters.error(),
+                "), running without --perf-counters.\n");
+        return counters.valid();
+    }
+
+    // the counters for a thread running tests, or null if the run does not have --perf-counters or they can't be opened
+    std::unique_ptr<PerfCounters> OpenPerfCounters(bool perf_counters)
+    {
+        if (!perf_counters)
+            return nullptr;
+        auto counters = std::make_unique<PerfCounters>();
+        return counters->valid() ? std::move(counters) : nullptr;
+    }
+
+    struct RunOptions
+    {
+        bool        verbose     = false;
+        bool        isolate     = false;
+        unsigned    jobs        = 1;
+        unsigned    shard_index = 0;
+        unsigned    shard_count = 1;
+        std::string xml;
+        std::string results_bin;
+        std::string jsonl;
+        std::string timings;
+        std::string timings_out;
+        TestFilter  filter;
+
+        std::chrono::milliseconds timeout{0};
+        PropertySettings          properties;
+        size_t                    report_slowest = 0;
+        bool                      perf_counters = false;
+        bool                      allocations   = false;
+        bool                      detect_leaks  = false;
+
+        bool                      benchmark = false;
+        std::chrono::milliseconds benchmark_time{10};
+        int                       benchmark_samples = 10;
+        std::string               benchmark_baseline;
+        std::string               benchmark_save;
+        double                    benchmark_threshold = 5.0;
+    };
+
+    // The value of an option given on the command line, or else in the environment variable `env`.
+    std::string FindOptionOrEnvironment(const std::vector<std::string>& args, std::initializer_list<const char*> names,
+        const std::string& what, const char* env)
+    {
+        auto value = FindOption(args, names, what);
+        if (value.empty())
+        {
+            auto env_value = std::getenv(env);
+            if (env_value)
+                value = env_value;
+        }
+        return value;
+    }
+
+    // --shard-index I --shard-count N (or GTEST_SHARD_INDEX and GTEST_TOTAL_SHARDS) runs just the I'th of N shards
+    // of the tests.
+    void FindShard(const std::vector<std::string>& args, RunOptions& options)
+    {
+        auto index = FindOptionOrEnvironment(args, {"--shard-index"}, "a shard index", "GTEST_SHARD_INDEX");
+        auto count = FindOptionOrEnvironment(args, {"--shard-count"}, "a shard count", "GTEST_TOTAL_SHARDS");
+        if (count.empty())
+            return;
+
+        auto n = std::stoi(count);
+        auto i = index.empty() ? 0 : std::stoi(index);
+        if (n < 1 || i < 0 || i >= n)
+            throw std::runtime_error("The shard index must be at least 0 and less than the shard count.");
+
+        options.shard_index = static_cast<unsigned>(i);
+        options.shard_count = static_cast<unsigned>(n);
+    }
+
+    // --timings FILE names the file the duration of each test is kept in between runs, by default it is the name of
+    // the executable with ".timings" on the end.
+    std::string FindTimingsFilename(const std::vector<std::string>& args)
+    {
+        auto filename = FindOption(args, {"--timings"}, "a filename for the test timings");
+        if (filename.empty() && !args.empty() && !args.front().empty())
+            filename = args.front() + ".timings";
+        return filename;
+    }
+
+    // --timings-out FILE writes the durations of this run to FILE. By default they go back to the --timings file, but
+    // a sharded run only reads it so that every shard, each with its own copy, splits the tests the same way.
+    std::string FindTimingsOutFilename(const std::vector<std::string>& args, const RunOptions& options)
+    {
+        auto filename = FindOption(args, {"--timings-out"}, "a filename for the test timings to be written to");
+        if (filename.empty() && options.shard_count == 1)
+            filename = options.timings;
+        return filename;
+    }
+
+    // --timeout-ms N reports any test that takes longer than N milliseconds as a timeout and moves on to the next
+    std::chrono::milliseconds FindTimeout(const std::vector<std::string>& args)
+    {
+        auto timeout = FindOption(args, {"--timeout-ms"}, "a timeout in milliseconds");
+        if (timeout.empty())
+            return std::chrono::milliseconds{0};
+
+        auto ms = std::stoll(timeout);
+        if (ms < 0)
+            throw std::runtime_error("The timeout can not be negative.");
+        return std::chrono::milliseconds(ms);
+    }
+
+    // --report-slowest N lists the N slowest tests at the end of the run, with how much slower or faster each was than
+    // in the last run (as kept in the --timings file), and the time taken by each suite.
+    size_t FindReportSlowest(const std::vector<std::string>& args)
+    {
+        auto slowest = FindOption(args, {"--report-slowest"}, "a number of tests");
+        if (slowest.empty())
+            return 0;
+
+        auto n = std::stoi(slowest);
+        if (n < 1)
+            throw std::runtime_error("The number of slowest tests to report must be at least 1.");
+        return static_cast<size_t>(n);
+    }
+
+    // --seed N makes the PROPERTY_TEST cases from N rather than a random seed, --property-cases N runs N cases of
+    // each property.
+    PropertySettings FindPropertySettings(const std::vector<std::string>& args)
+    {
+        auto settings = PropertySettings{};
+        auto seed     = FindOption(args, {"--seed"}, "a seed");
+        settings.seed = seed.empty() ? (uint64_t{std::random_device()()} << 32) ^ std::random_device()() :
+                                       std::stoull(seed);
+
+        auto cases = FindOption(args, {"--property-cases"}, "a number of property cases");
+        if (!cases.empty())
+        {
+            settings.cases = std::stoi(cases);
+            if (settings.cases < 1)
+                throw std::runtime_error("The number of property cases must be at least 1.");
+        }
+        return settings;
+    }
+
+    // --benchmark runs the benchmarks rather than the tests. Each is run for --benchmark-samples N samples (10 by
+    // default) of a number of iterations chosen so a sample takes about --benchmark-time MS (10ms by default).
+    // --benchmark-save FILE keeps the samples, --benchmark-baseline FILE compares them with ones saved before and fails
+    // the run if a benchmark is significantly slower by more than --benchmark-threshold PERCENT (5 by default).
+    void FindBenchmarkSettings(const std::vector<std::string>& args, RunOptions& options)
+    {
+        options.benchmark = std::find(begin(args), end(args), "--benchmark") != end(args);
+
+        auto time = FindOption(args, {"--benchmark-time"}, "a benchmark time in milliseconds");
+        if (!time.empty())
+        {
+            options.benchmark_time = std::chrono::milliseconds(std::stoll(time));
+            if (options.benchmark_time.count() < 1)
+                throw std::runtime_error("The benchmark time must be at least 1ms.");
+        }
+
+        auto samples = FindOption(args, {"--benchmark-samples"}, "a number of benchmark samples");
+        if (!samples.empty())
+        {
+            options.benchmark_samples = std::stoi(samples);
+            if (options.benchmark_samples < 1)
+                throw std::runtime_error("The number of benchmark samples must be at least 1.");
+        }
+
+        options.benchmark_baseline = FindOption(args, {"--benchmark-baseline"}, "a benchmark baseline filename");
+        options.benchmark_save     = FindOption(args, {"--benchmark-save"}, "a filename to save the benchmarks in");
+
+        auto threshold = FindOption(args, {"--benchmark-threshold"}, "a benchmark threshold percentage");
+        if (!threshold.empty())
+        {
+            options.benchmark_threshold = std::stod(threshold);
+            if (options.benchmark_threshold < 0)
+                throw std::runtime_error("The benchmark threshold can not be negative.");
+        }
+    }
+
+    // the PROPERTY_TEST settings of the run on this thread, a test can run a suite of its own so they are not global
+    thread_local PropertySettings current_properties;
+
+    RunOptions ParseOptions(const std::vector<std::string>& args)
+    {
+        auto options           = RunOptions{};
+        options.isolate        = std::find(begin(args), end(args), "--isolate") != end(args);
+        options.jobs           = FindJobs(args);
+        options.xml            = FindXMLFilename(args);
+        options.results_bin    = FindOption(args, {"--results-bin"}, "a filename for the results log");
+        options.jsonl          = FindOption(args, {"--jsonl"}, "a filename for the JSON lines");
+        options.timings        = FindTimingsFilename(args);
+        options.filter         = TestFilter(FindOption(args, {"--filter"}, "a test filter"));
+        options.timeout        = FindTimeout(args);
+        options.properties     = FindPropertySettings(args);
+        options.report_slowest = FindReportSlowest(args);
+        options.perf_counters  = std::find(begin(args), end(args), "--perf-counters") != end(args);
+        options.allocations    = std::find(begin(args), end(args), "--allocations") != end(args);
+        options.detect_leaks   = std::find(begin(args), end(args), "--detect-leaks") != end(args);
+        FindShard(args, options);
+        options.timings_out = FindTimingsOutFilename(args, options);
+        FindBenchmarkSettings(args, options);
+        return options;
+    }
+
+    // Any number of these can be given at once : --results-bin FILE writes a results log for testframework_results to
+    // read, --xml FILE (or -x FILE) writes JUnit XML and --jsonl FILE writes JSON lines. The results are shown on the
+    // output stream too, unless it has the JSON lines (--jsonl -).
+    std::unique_ptr<Reporter> MakeReporter(const RunOptions& options, std::ostream& os)
+    {
+        auto reporters = std::vector<std::unique_ptr<Reporter>>{};
+        if (options.jsonl != "-")
+            reporters.push_back(std::make_unique<StreamReporter>(os, options.verbose, options.report_slowest));
+        if (!options.results_bin.empty())
+        {
+#if defined(TESTFRAMEWORK_HAS_MMAP)
+            reporters.push_back(std::make_unique<BinaryReporter>(options.results_bin));
+#else
+            throw std::runtime_error("--results-bin is not supported on this platform.");
+#endif
+        }
+        if (!options.xml.empty())
+            reporters.push_back(std::make_unique<XMLReporter>(options.xml));
+        if (!options.jsonl.empty())
+            reporters.push_back(std::make_unique<JsonLinesReporter>(options.jsonl, os));
+
+        // with --isolate the tests run in other processes so reporting does not hold them up, and a thread here could
+        // be holding a lock when a worker is forked, which the worker would then wait for forever
+        return std::make_unique<FanOutReporter>(std::move(reporters), !options.isolate);
+    }
+
+    int MiniSuite::RunTests(const std::vector<std::string>& args, std::ostream& os)
+    {
+        auto options    = ParseOptions(args);
+        options.verbose = IsVerbose(args);
+        if (options.perf_counters)
+            options.perf_counters = CheckPerfCounters(os);
+        if ((options.allocations || options.detect_leaks) && !AllocationHooksInstalled())
+        {
+            print(os, "The allocation hooks are not installed (define TEST_ALLOCATION_HOOKS), running without ",
+                options.allocations ? "--allocations" : "--detect-leaks", ".\n");
+            options.allocations  = false;
+            options.detect_leaks = false;
+        }
+        if (options.benchmark)
+            return run_benchmarks(options, os);
+
+        auto start_time = std::chrono::steady_clock::now();
+
+        auto reporter = MakeReporter(options, os);
+
+        auto properties    = current_properties;
+        current_properties = options.properties;
+        run_tests(options, *reporter);
+        current_properties = properties;
+        auto end_time = std::chrono::steady_clock::now();
+        auto failures = reporter->report();
+        // JSON lines on the output stream are for a program to read, so they are left as they are
+        if (options.jsonl != "-")
+        {
+            auto taken = std::chrono::duration<double, std::milli>(end_time - start_time);
+            print(os, "\nTime taken = ", taken.count(), "ms\n");
+        }
+        return failures;
+    }
+
+    // A single (test, param index) pair, the unit of work the runners schedule.
+    struct WorkItem
+    {
+        // used for a work item that has no recorded duration
+        static constexpr std::chrono::nanoseconds unknown{-1};
+
+        const MiniSuite::Node*   test;
+        int                      index;
+        std::chrono::nanoseconds expected = unknown;
+        std::chrono::nanoseconds duration = unknown;
+
+        WorkItem(const MiniSuite::Node* t, int i) : test(t), index(i)
+        {
+        }
+    };
+
+    constexpr std::chrono::nanoseconds WorkItem::unknown;
+
+    // The blocks a test allocated on its thread and did not free, and the sizes of the biggest of them.
+    struct LeakCounts
+    {
+        static constexpr size_t max_sizes = 8;
+
+        uint64_t blocks    = 0;
+        uint64_t bytes     = 0;
+        size_t   num_sizes = 0;
+        uint64_t sizes[max_sizes]{};
+    };
+
+    constexpr size_t LeakCounts::max_sizes;
+
+    // --detect-leaks keeps track of each block allocated on the thread between StartLeakCheck and StopLeakCheck, a
+    // block freed on any thread is forgotten. What is left when the check stops has leaked, or is being kept on purpose
+    // (e.g. a cache filled the first time it is used). Blocks allocated by threads the test starts are not tracked.
+    // Checks can be nested, StartLeakCheck returns the check to go back to.
+    uint64_t   StartLeakCheck();
+    LeakCounts StopLeakCheck(uint64_t previous);
+
+    // What a thread running tests measures around each one, set up on that thread from the options of the run.
+    struct Instruments
+    {
+        std::unique_ptr<PerfCounters> counters; // null without --perf-counters
+        bool                          allocations;
+        bool                          leaks;
+
+        explicit Instruments(const RunOptions& options)
+            : counters(OpenPerfCounters(options.perf_counters)), allocations(options.allocations),
+              leaks(options.detect_leaks)
+        {
+        }
+    };
+
+    std::string LeakMessage(const LeakCounts& leaks)
+    {
+        auto s = std::ostringstream{};
+        s << "Test leaked " << leaks.blocks << (leaks.blocks == 1 ? " block" : " blocks") << " (" << leaks.bytes
+          << " bytes)";
+        for (auto i = size_t{0}; i != leaks.num_sizes; ++i)
+            s << (i == 0 ? " of sizes " : ", ") << leaks.sizes[i];
+        if (leaks.blocks > leaks.num_sizes)
+            s << ", ...";
+        return s.str();
+    }
+
+    // the CPU time used by the calling thread, or by the whole process where that is all there is
+    std::chrono::nanoseconds ThreadCpuTime()
+    {
+#if defined(CLOCK_THREAD_CPUTIME_ID)
+        timespec now;
+        clock_gettime(CLOCK_THREAD_CPUTIME_ID, &now);
+        return std::chrono::seconds(now.tv_sec) + std::chrono::nanoseconds(now.tv_nsec);
+#elif defined(_WIN32)
+        FILETIME created, exited, kernel, user;
+        GetThreadTimes(GetCurrentThread(), &created, &exited, &kernel, &user);
+        auto ticks = [](const FILETIME& t) { return (uint64_t{t.dwHighDateTime} << 32) | t.dwLowDateTime; };
+        return std::chrono::nanoseconds(100 * (ticks(kernel) + ticks(user)));
+#else
+        return std::chrono::nanoseconds(static_cast<int64_t>(1e9 * std::clock() / CLOCKS_PER_SEC));
+#endif
+    }
+
+    // What running a WorkItem produced, held until it can be handed to the Reporter.
+    struct Outcome
+    {
+        int                      error = Reporter::Passed;
+        std::string              msg;
+        std::chrono::nanoseconds duration{0};
+        std::chrono::nanoseconds cpu_time{0};
+        PerfCounts               counts;
+        bool                     counted_allocations = false;
+        AllocationCounts         allocations;
+    };
+
+    Outcome TimeoutOutcome(
+        std::chrono::milliseconds timeout, const char* file, int line, std::chrono::nanoseconds duration)
+    {
+        auto outcome     = Outcome{};
+        outcome.error    = Reporter::Failed;
+        auto message     = "Test took longer than " + std::to_string(timeout.count()) + "ms";
+        outcome.msg      = TestTimeout(message, file, line).what();
+        outcome.duration = duration;
+        return outcome;
+    }
+
+    // The work item running on a thread and its time limit, which is --timeout-ms unless the test changes it with
+    // TIMEOUT(ms). A watchdog on another thread can abandon the test once it has overrun.
+    class TestSlot
+    {
+    public:
+        using notify_function = std::function<void(std::chrono::milliseconds, const char*, int)>;
+
+        explicit TestSlot(std::chrono::milliseconds timeout, notify_function notify = nullptr)
+            : m_default_timeout(timeout), m_notify(std::move(notify))
+        {
+        }
+
+        void start(size_t item, const MiniSuite::Node& test)
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_item    = item;
+            m_running = true;
+            m_start   = std::chrono::steady_clock::now();
+            m_timeout = m_default_timeout;
+            m_file    = test.File();
+            m_line    = test.Line();
+        }
+
+        // returns false if the watchdog has abandoned the test, its outcome has already been reported
+        bool finish()
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_running = false;
+            return !m_abandoned;
+        }
+
+        void set_timeout(std::chrono::milliseconds timeout, const char* file, int line)
+        {
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                m_timeout = timeout;
+                m_file    = file;
+                m_line    = line;
+            }
+            if (m_notify)
+                m_notify(timeout, file, line);
+        }
+
+        bool overrun(std::chrono::steady_clock::time_point now) const
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            return overrun_locked(now);
+        }
+
+        Outcome timeout_outcome(std::chrono::steady_clock::time_point now) const
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            return TimeoutOutcome(m_timeout, m_file, m_line, now - m_start);
+        }
+
+        // called by the watchdog, if the test has overrun the slot is abandoned and the item and its outcome given
+        bool abandon_if_overrun(size_t& item, Outcome& outcome)
+        {
+            auto                        now = std::chrono::steady_clock::now();
+            std::lock_guard<std::mutex> lock(m_mutex);
+            if (!overrun_locked(now))
+                return false;
+
+            m_abandoned = true;
+            item        = m_item;
+            outcome     = TimeoutOutcome(m_timeout, m_file, m_line, now - m_start);
+            return true;
+        }
+
+    private:
+        bool overrun_locked(std::chrono::steady_clock::time_point now) const
+        {
+            return m_running && m_timeout.count() != 0 && now - m_start > m_timeout;
+        }
+
+        mutable std::mutex                    m_mutex;
+        std::chrono::milliseconds             m_default_timeout;
+        notify_function                       m_notify;
+        size_t                                m_item      = 0;
+        bool                                  m_running   = false;
+        bool                                  m_abandoned = false;
+        std::chrono::steady_clock::time_point m_start;
+        std::chrono::milliseconds             m_timeout{0};
+        const char*                           m_file = nullptr;
+        int                                   m_line = 0;
+    };
+
+    thread_local TestSlot* current_slot = nullptr;
+
+    // the number of threads left running tests that overran their time limit
+    std::atomic<int> abandoned_threads{0};
+
+    std::vector<TestFailure>& RecordedFailures()
+    {
+        thread_local std::vector<TestFailure> failures;
+        return failures;
+    }
+
+    // The failures the EXPECT_* checks of a test recorded come ahead of the message of whatever ended it, a test that
+    // recorded any has failed unless it ended in an error.
+    void AddRecordedFailures(Outcome& outcome, const std::vector<TestFailure>& failures)
+    {
+        if (failures.empty())
+            return;
+
+        auto msg = std::string{};
+        for (auto& failure : failures)
+            msg += std::string(failure.what()) + "\n";
+        if (outcome.error == Reporter::Error || outcome.error == Reporter::Failed)
+            msg += outcome.msg;
+        else
+            msg.pop_back();
+
+        if (outcome.error != Reporter::Error)
+            outcome.error = Reporter::Failed;
+        outcome.msg = std::move(msg);
+    }
+
+    void SetTimeout(int milliseconds, const char* file, int line)
+    {
+        if (current_slot)
+            current_slot->set_timeout(std::chrono::milliseconds(milliseconds), file, line);
+    }
+
+    // Runs the work item, a test that overran its time limit is reported as a timeout even if it went on to finish.
+    // The work item is copied as the work list may be gone by the time an abandoned test finishes.
+    Outcome RunWorkItem(WorkItem item, size_t item_index, TestSlot& slot, Instruments& instruments)
+    {
+        slot.start(item_index, *item.test);
+        current_slot = &slot;
+
+        // a test that runs a suite of its own has its recorded failures put aside while the inner tests run
+        RecordingScope recording;
+
+        auto outcome     = Outcome{};
+        auto counters    = instruments.counters.get();
+        auto allocations = ThreadAllocations();
+        auto leak_check  = instruments.leaks ? StartLeakCheck() : 0;
+        auto start       = std::chrono::steady_clock::now();
+        auto cpu_start   = ThreadCpuTime();
+        if (counters)
+            counters->start();
+        try
+        {
+            item.test->Run(item.index);
+        }
+        catch (TestFailure& e)
+        {
+            outcome.error = Reporter::Failed;
+            outcome.msg   = e.what();
+        }
+        catch (TestSkipped&)
+        {
+            outcome.error = Reporter::Skipped;
+        }
+        catch (const std::exception& e)
+        {
+            outcome.error = Reporter::Error;
+            outcome.msg   = e.what();
+        }
+        catch (...)
+        {
+            outcome.error = Reporter::Error;
+            outcome.msg   = "Unknown exception";
+        }
+        AddRecordedFailures(outcome, recording.take());
+        if (counters)
+            outcome.counts = counters->stop();
+        outcome.counted_allocations = instruments.allocations;
+        outcome.allocations         = ThreadAllocations() - allocations;
+        if (instruments.leaks)
+        {
+            // only a test that passed is checked, the message of a failure is allocated while the check is going on
+            auto leaks = StopLeakCheck(leak_check);
+            if (outcome.error == Reporter::Passed && leaks.blocks != 0)
+            {
+                outcome.error = Reporter::Failed;
+                outcome.msg   = TestLeak(LeakMessage(leaks), item.test->File(), item.test->Line()).what();
+            }
+        }
+        auto end         = std::chrono::steady_clock::now();
+        outcome.duration = end - start;
+        outcome.cpu_time = ThreadCpuTime() - cpu_start;
+        current_slot     = nullptr;
+
+        if (slot.overrun(end))
+            outcome = slot.timeout_outcome(end);
+        return outcome;
+    }
+
+    void StartWorkItem(Reporter& reporter, const WorkItem& item)
+    {
+        auto& test   = *item.test;
+        auto  indexs = std::string(test.NumTests() == 1 ? "" : "[" + std::to_string(item.index) + "]");
+        reporter.start_test(test.Suite(), test.Name(indexs), test.BareName(indexs));
+    }
+
+    void EndWorkItem(Reporter& reporter, const WorkItem& item, const Outcome& outcome)
+    {
+        if (outcome.counts.valid)
+        {
+            std::stringstream ipc;
+            ipc << std::fixed << std::setprecision(2) << outcome.counts.ipc();
+            reporter.add_property("cycles", std::to_string(outcome.counts.cycles));
+            reporter.add_property("instructions", std::to_string(outcome.counts.instructions));
+            reporter.add_property("ipc", ipc.str());
+            reporter.add_property("cache-misses", std::to_string(outcome.counts.cache_misses));
+            reporter.add_property("branch-misses", std::to_string(outcome.counts.branch_misses));
+        }
+        if (outcome.counted_allocations)
+        {
+            reporter.add_property("allocations", std::to_string(outcome.allocations.allocations));
+            reporter.add_property("allocated-bytes", std::to_string(outcome.allocations.bytes));
+        }
+        if (outcome.error == Reporter::Failed)
+            reporter.add_failure(outcome.msg);
+        else if (outcome.error == Reporter::Error)
+            reporter.add_error(outcome.msg);
+        else if (outcome.error == Reporter::Skipped)
+            reporter.add_skipped();
+        auto previous = item.expected == WorkItem::unknown ? std::chrono::nanoseconds{-1} : item.expected;
+        reporter.add_times(outcome.duration, outcome.cpu_time, previous);
+        reporter.end_test();
+    }
+
+    inline uint64_t StableHash(const char* suite, const char* name, int index)
+    {
+        auto hash = StableHash(suite, std::strlen(suite) + 1);
+        hash      = StableHash(name, std::strlen(name) + 1, hash);
+        for (auto shift = 0; shift != 32; shift += 8)
+        {
+            hash = (hash ^ ((static_cast<uint32_t>(index) >> shift) & 0xff)) * 1099511628211ULL;
+        }
+        return hash;
+    }
+
+    // The duration of every work item from previous runs, kept in a file as a header followed by (hash, nanoseconds)
+    // pairs sorted by hash, the hash being StableHash(suite, name, index). Entries for work items that were not run
+    // this time (e.g. they belong to another shard) are kept.
+    class TimingDatabase
+    {
+    public:
+        // a file that is not a timings database, or is cut short or corrupt, is ignored and replaced when it is saved
+        void load(const std::string& filename)
+        {
+            auto f      = std::ifstream(filename, std::ios::binary | std::ios::ate);
+            auto size   = static_cast<uint64_t>(std::max<std::streamoff>(0, f.tellg()));
+            auto header = Header{};
+            if (!f.seekg(0).read(reinterpret_cast<char*>(&header), sizeof header) || header.magic != magic ||
+                header.version != version || header.count != (size - sizeof header) / sizeof(Entry) ||
+                (size - sizeof header) % sizeof(Entry) != 0)
+                return;
+
+            m_durations.resize(static_cast<size_t>(header.count));
+            auto out_of_order = [](const Entry& lhs, const Entry& rhs) { return lhs.hash >= rhs.hash; };
+            if (!f.read(reinterpret_cast<char*>(m_durations.data()),
+                    static_cast<std::streamsize>(m_durations.size() * sizeof(Entry))) ||
+                std::adjacent_find(begin(m_durations), end(m_durations), out_of_order) != end(m_durations))
+                m_durations.clear();
+        }
+
+        void save(const std::string& filename) const
+        {
+            auto f      = std::ofstream(filename, std::ios::binary);
+            auto header = Header{magic, version, m_durations.size()};
+            f.write(reinterpret_cast<const char*>(&header), sizeof header);
+            f.write(reinterpret_cast<const char*>(m_durations.data()),
+                static_cast<std::streamsize>(m_durations.size() * sizeof(Entry)));
+        }
+
+        std::chrono::nanoseconds find(const WorkItem& item) const
+        {
+            auto hash = key(item);
+            auto pos  = std::lower_bound(begin(m_durations), end(m_durations), hash, by_hash);
+            return pos != end(m_durations) && pos->hash == hash ? std::chrono::nanoseconds(pos->nanoseconds) :
+                                                                  WorkItem::unknown;
+        }
+
+        // record the durations of the work items that were run, replacing any earlier ones
+        void record(const std::vector<WorkItem>& items)
+        {
+            auto recorded = std::vector<Entry>{};
+            for (auto& item : items)
+            {
+                if (item.duration != WorkItem::unknown)
+                    recorded.push_back(Entry{key(item), item.duration.count()});
+            }
+            std::sort(begin(recorded), end(recorded), [](auto& lhs, auto& rhs) { return lhs.hash < rhs.hash; });
+
+            auto merged = std::vector<Entry>{};
+            merged.reserve(m_durations.size() + recorded.size());
+            auto old = begin(m_durations);
+            for (auto& entry : recorded)
+            {
+                for (; old != end(m_durations) && old->hash <= entry.hash; ++old)
+                {
+                    if (old->hash != entry.hash)
+                        merged.push_back(*old);
+                }
+                if (merged.empty() || merged.back().hash != entry.hash)
+                    merged.push_back(entry);
+            }
+            merged.insert(end(merged), old, end(m_durations));
+            m_durations = std::move(merged);
+        }
+
+    private:
+        static constexpr uint32_t magic   = 0x4d544654; // "TFTM"
+        static constexpr uint32_t version = 1;
+
+        struct Header
+        {
+            uint32_t magic;
+            uint32_t version;
+            uint64_t count;
+        };
+
+        struct Entry
+        {
+            uint64_t hash;
+            int64_t  nanoseconds;
+        };
+
+        static bool by_hash(const Entry& entry, uint64_t hash)
+        {
+            return entry.hash < hash;
+        }
+
+        static uint64_t key(const WorkItem& item)
+        {
+            return StableHash(item.test->Suite(), item.test->BareName(), item.index);
+        }
+
+        std::vector<Entry> m_durations;
+    };
+
+    constexpr uint32_t TimingDatabase::magic;
+    constexpr uint32_t TimingDatabase::version;
+
+    // The expected duration of each work item, those with no recorded duration are expected to take the average.
+    std::vector<std::chrono::nanoseconds> ExpectedDurations(const std::vector<WorkItem>& items)
+    {
+        auto known = std::chrono::nanoseconds::rep{0};
+        auto total = std::chrono::nanoseconds{0};
+        for (auto& item : items)
+        {
+            if (item.expected != WorkItem::unknown)
+            {
+                ++known;
+                total += item.expected;
+            }
+        }
+        auto average = known != 0 ? total / known : std::chrono::nanoseconds{1};
+
+        auto expected = std::vector<std::chrono::nanoseconds>{};
+        expected.reserve(items.size());
+        for (auto& item : items)
+        {
+            expected.push_back(item.expected != WorkItem::unknown ? item.expected : average);
+        }
+        return expected;
+    }
+
+    // The indexes of the work items ordered from the longest expected duration to the shortest, so that the slow
+    // ones are not left until last.
+    std::vector<size_t> LongestFirst(const std::vector<std::chrono::nanoseconds>& expected)
+    {
+        auto order = std::vector<size_t>(expected.size());
+        std::iota(begin(order), end(order), size_t{0});
+        std::stable_sort(
+            begin(order), end(order), [&](size_t lhs, size_t rhs) { return expected[lhs] > expected[rhs]; });
+        return order;
+    }
+
+    // Splits the work items between `count` shards by the longest processing time first rule : in turn, from the
+    // longest expected duration to the shortest, each work item goes to the shard with the least total so far. Every
+    // shard must see the same timings file to agree on the split, which is why a sharded run does not write the
+    // durations back to it (see --timings-out). Returns the work items for shard `index` in their original order.
+    std::vector<WorkItem> SelectShard(const std::vector<WorkItem>& items, unsigned index, unsigned count)
+    {
+        // a min heap of (load, shard), so ties go to the lowest shard
+        using Load    = std::pair<std::chrono::nanoseconds, unsigned>;
+        auto expected = ExpectedDurations(items);
+        auto loads    = std::vector<Load>{};
+        for (auto shard = 0U; shard != count; ++shard)
+            loads.emplace_back(std::chrono::nanoseconds{0}, shard);
+        auto selected = std::vector<char>(items.size(), 0);
+        for (auto i : LongestFirst(expected))
+        {
+            std::pop_heap(begin(loads), end(loads), std::greater<Load>());
+            loads.back().first += expected[i];
+            selected[i] = loads.back().second == index;
+            std::push_heap(begin(loads), end(loads), std::greater<Load>());
+        }
+
+        auto shard = std::vector<WorkItem>{};
+        for (auto i = size_t{0}; i != items.size(); ++i)
+        {
+            if (selected[i])
+                shard.push_back(items[i]);
+        }
+        return shard;
+    }
+
+    // A deque of indexes into the work list, the owning thread takes work from the front and idle threads steal from
+    // the back.
+    class WorkStealingQueue
+    {
+    public:
+        void push(size_t item)
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_items.push_back(item);
+        }
+
+        bool pop(size_t& item)
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            if (m_items.empty())
+                return false;
+            item = m_items.front();
+            m_items.pop_front();
+            return true;
+        }
+
+        bool steal(size_t& item)
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            if (m_items.empty())
+                return false;
+            item = m_items.back();
+            m_items.pop_back();
+            return true;
+        }
+
+    private:
+        std::mutex         m_mutex;
+        std::deque<size_t> m_items;
+    };
+
+    // Hands outcomes, which may finish in any order, to the reporter in work list order as soon as every work item
+    // before them has been reported, so the report is the same as a single threaded run. Only the outcomes waiting
+    // for an earlier one are kept, not one for every work item.
+    class OrderedOutcomes
+    {
+    public:
+        OrderedOutcomes(std::vector<WorkItem>& items, Reporter& reporter) : m_items(items), m_reporter(reporter)
+        {
+        }
+
+        void add(size_t item, Outcome outcome)
+        {
+            m_items[item].duration = outcome.duration;
+            m_waiting.emplace(item, std::move(outcome));
+            for (auto next = m_waiting.begin(); next != m_waiting.end() && next->first == m_next;
+                 next      = m_waiting.begin())
+            {
+                StartWorkItem(m_reporter, m_items[m_next]);
+                EndWorkItem(m_reporter, m_items[m_next], next->second);
+                m_waiting.erase(next);
+                ++m_next;
+            }
+        }
+
+        bool complete() const
+        {
+            return m_next == m_items.size();
+        }
+
+    private:
+        std::vector<WorkItem>&    m_items;
+        Reporter&                 m_reporter;
+        std::map<size_t, Outcome> m_waiting;
+        size_t                    m_next = 0;
+    };
+
+    // Runs the work items on `jobs` threads, dealing them out longest first. The calling thread acts as a watchdog,
+    // when a test overruns its time limit it is reported as a timeout and its thread is abandoned to finish (or not)
+    // in its own time, with a new thread taking over its deque.
+    void RunParallel(std::vector<WorkItem>& items, unsigned jobs, const RunOptions& options, Reporter& reporter)
+    {
+        auto queues = std::vector<WorkStealingQueue>(jobs);
+        auto order  = LongestFirst(ExpectedDurations(items));
+        for (auto i = size_t{0}; i != order.size(); ++i)
+        {
+            queues[i % jobs].push(order[i]);
+        }
+
+        auto                    outcomes = OrderedOutcomes(items, reporter);
+        std::mutex              mutex;
+        std::condition_variable complete;
+
+        // once its slot is abandoned a thread must not touch anything but the slot, this function may have returned
+        auto properties = current_properties;
+        auto work       = [&](std::shared_ptr<TestSlot> slot, unsigned self) {
+            current_properties = properties;
+            auto instruments   = Instruments(options);
+            auto item          = size_t{0};
+            for (;;)
+            {
+                auto found = queues[self].pop(item);
+                for (auto victim = (self + 1) % jobs; !found && victim != self; victim = (victim + 1) % jobs)
+                {
+                    found = queues[victim].steal(item);
+                }
+                if (!found)
+                    return;
+
+                auto outcome = RunWorkItem(items[item], item, *slot, instruments);
+                if (!slot->finish())
+                {
+                    --abandoned_threads;
+                    return;
+                }
+
+                std::lock_guard<std::mutex> lock(mutex);
+                outcomes.add(item, std::move(outcome));
+                if (outcomes.complete())
+                    complete.notify_one();
+            }
+        };
+
+        struct Worker
+        {
+            std::shared_ptr<TestSlot> slot;
+            std::thread               thread;
+        };
+
+        auto start_worker = [&](unsigned self) {
+            auto worker   = Worker{};
+            worker.slot   = std::make_shared<TestSlot>(options.timeout);
+            worker.thread = std::thread(work, worker.slot, self);
+            return worker;
+        };
+
+        auto workers = std::vector<Worker>{};
+        for (auto self = 0U; self != jobs; ++self)
+        {
+            workers.push_back(start_worker(self));
+        }
+
+        for (;;)
+        {
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                if (complete.wait_for(lock, std::chrono::milliseconds(10), [&] { return outcomes.complete(); }))
+                    break;
+            }
+
+            for (auto self = 0U; self != jobs; ++self)
+            {
+                auto item    = size_t{0};
+                auto outcome = Outcome{};
+                if (workers[self].slot->abandon_if_overrun(item, outcome))
+                {
+                    workers[self].thread.detach();
+                    ++abandoned_threads;
+                    {
+                        std::lock_guard<std::mutex> lock(mutex);
+                        outcomes.add(item, std::move(outcome));
+                    }
+                    workers[self] = start_worker(self);
+                }
+            }
+        }
+
+        for (auto& worker : workers)
+        {
+            worker.thread.join();
+        }
+    }
+
+#if defined(TESTFRAMEWORK_HAS_FORK)
+    // --isolate runs the tests in a pool of forked worker processes. The parent writes the index of a work item down
+    // each worker's command pipe and reads the outcome back from its result pipe; if the result pipe closes before
+    // the outcome arrives the worker died, the test it was running is reported as an error and the worker is
+    // replaced.
+    namespace isolation
+    {
+        inline bool read_fully(int fd, void* buffer, size_t size)
+        {
+            auto p = static_cast<char*>(buffer);
+            while (size != 0)
+            {
+                auto n = ::read(fd, p, size);
+                if (n < 0 && errno == EINTR)
+                    continue;
+                if (n <= 0)
+                    return false;
+                p += n;
+                size -= static_cast<size_t>(n);
+            }
+            return true;
+        }
+
+        inline bool write_fully(int fd, const void* buffer, size_t size)
+        {
+            auto p = static_cast<const char*>(buffer);
+            while (size != 0)
+            {
+                auto n = ::write(fd, p, size);
+                if (n < 0 && errno == EINTR)
+                    continue;
+                if (n <= 0)
+                    return false;
+                p += n;
+                size -= static_cast<size_t>(n);
+            }
+            return true;
+        }
+
+        // each message from a worker starts with its kind
+        enum : uint32_t
+        {
+            OutcomeMessage,
+            TimeoutMessage
+        };
+
+        inline bool write_timeout(int fd, std::chrono::milliseconds timeout, const char* file, int line)
+        {
+            auto kind         = uint32_t{TimeoutMessage};
+            auto milliseconds = static_cast<int64_t>(timeout.count());
+            auto line32       = static_cast<int32_t>(line);
+            auto size         = static_cast<uint64_t>(std::strlen(file));
+            return write_fully(fd, &kind, sizeof kind) && write_fully(fd, &milliseconds, sizeof milliseconds) &&
+                   write_fully(fd, &line32, sizeof line32) && write_fully(fd, &size, sizeof size) &&
+                   write_fully(fd, file, static_cast<size_t>(size));
+        }
+
+        inline bool write_outcome(int fd, uint64_t item, const Outcome& outcome)
+        {
+            auto kind = uint32_t{OutcomeMessage};
+            if (!write_fully(fd, &kind, sizeof kind))
+                return false;
+
+            // the counts are plain data and the worker is a fork of this process, so they are sent as they are
+            auto error    = static_cast<int32_t>(outcome.error);
+            auto duration = static_cast<int64_t>(outcome.duration.count());
+            auto cpu_time = static_cast<int64_t>(outcome.cpu_time.count());
+            auto size     = static_cast<uint64_t>(outcome.msg.size());
+            return write_fully(fd, &item, sizeof item) && write_fully(fd, &error, sizeof error) &&
+                   write_fully(fd, &duration, sizeof duration) && write_fully(fd, &cpu_time, sizeof cpu_time) &&
+                   write_fully(fd, &outcome.counts, sizeof outcome.counts) &&
+                   write_fully(fd, &outcome.counted_allocations, sizeof outcome.counted_allocations) &&
+                   write_fully(fd, &outcome.allocations, sizeof outcome.allocations) &&
+                   write_fully(fd, &size, sizeof size) && write_fully(fd, outcome.msg.data(), outcome.msg.size());
+        }
+
+        inline bool read_outcome(int fd, uint64_t& item, Outcome& outcome)
+        {
+            auto error    = int32_t{0};
+            auto duration = int64_t{0};
+            auto cpu_time = int64_t{0};
+            auto size     = uint64_t{0};
+            if (!read_fully(fd, &item, sizeof item) || !read_fully(fd, &error, sizeof error) ||
+                !read_fully(fd, &duration, sizeof duration) || !read_fully(fd, &cpu_time, sizeof cpu_time) ||
+                !read_fully(fd, &outcome.counts, sizeof outcome.counts) ||
+                !read_fully(fd, &outcome.counted_allocations, sizeof outcome.counted_allocations) ||
+                !read_fully(fd, &outcome.allocations, sizeof outcome.allocations) ||
+                !read_fully(fd, &size, sizeof size))
+                return false;
+
+            outcome.error    = error;
+            outcome.duration = std::chrono::nanoseconds(duration);
+            outcome.cpu_time = std::chrono::nanoseconds(cpu_time);
+            outcome.msg.resize(static_cast<size_t>(size));
+            return read_fully(fd, &outcome.msg[0], outcome.msg.size());
+        }
+
+        struct Worker
+        {
+            pid_t  pid      = -1;
+            int    commands = -1;
+            int    results  = -1;
+            size_t current  = 0;
+            bool   busy     = false;
+
+            // the time limit on the current test, the file name is kept as TIMEOUT(ms) sends it from the worker
+            std::chrono::steady_clock::time_point start;
+            std::chrono::milliseconds             timeout{0};
+            std::string                           file;
+            int                                   line = 0;
+        };
+
+        // TIMEOUT(ms) in a test tells the parent about the new time limit, the parent does the timing
+        [[noreturn]] inline void worker_main(
+            const std::vector<WorkItem>& items, const RunOptions& options, int commands, int results)
+        {
+            auto instruments = Instruments(options);
+            TestSlot slot(std::chrono::milliseconds{0},
+                [results](std::chrono::milliseconds timeout, const char* file, int line) {
+                    write_timeout(results, timeout, file, line);
+                });
+            auto item = uint64_t{0};
+            while (read_fully(commands, &item, sizeof item))
+            {
+                auto index   = static_cast<size_t>(item);
+                auto outcome = RunWorkItem(items[index], index, slot, instruments);
+                std::cout.flush();
+                std::fflush(stdout);
+                if (!write_outcome(results, item, outcome))
+                    break;
+            }
+            // skip static destructors and atexit handlers, they belong to the parent
+            _exit(0);
+        }
+
+        inline Worker start_worker(
+            const std::vector<WorkItem>& items, const RunOptions& options, const std::vector<Worker>& workers)
+        {
+            int commands[2];
+            int results[2];
+            if (pipe(commands) != 0)
+                throw std::runtime_error("Unable to create a pipe for an isolated test worker.");
+            if (pipe(results) != 0)
+            {
+                close(commands[0]);
+                close(commands[1]);
+                throw std::runtime_error("Unable to create a pipe for an isolated test worker.");
+            }
+
+            std::cout.flush();
+            std::fflush(stdout);
+            auto pid = fork();
+            if (pid < 0)
+                throw std::runtime_error("Unable to fork an isolated test worker.");
+
+            if (pid == 0)
+            {
+                for (auto& other : workers)
+                {
+                    close(other.commands);
+                    close(other.results);
+                }
+                close(commands[1]);
+                close(results[0]);
+                worker_main(items, options, commands[0], results[1]);
+            }
+
+            close(commands[0]);
+            close(results[1]);
+
+            auto worker     = Worker{};
+            worker.pid      = pid;
+            worker.commands = commands[1];
+            worker.results  = results[0];
+            return worker;
+        }
+
+        inline void stop_worker(Worker& worker, int& status)
+        {
+            close(worker.commands);
+            close(worker.results);
+            while (waitpid(worker.pid, &status, 0) < 0 && errno == EINTR)
+            {
+            }
+            worker = Worker{};
+        }
+
+        inline std::string describe_exit(int status)
+        {
+            auto s = std::ostringstream{};
+            if (WIFSIGNALED(status))
+                s << "Test crashed with signal " << WTERMSIG(status) << " (" << strsignal(WTERMSIG(status)) << ")";
+            else if (WIFEXITED(status))
+                s << "Test exited the process with status " << WEXITSTATUS(status);
+            else
+                s << "Test process stopped unexpectedly";
+            return s.str();
+        }
+    } // namespace isolation
+
+    void RunIsolated(std::vector<WorkItem>& items, unsigned jobs, const RunOptions& options, Reporter& reporter)
+    {
+        using namespace isolation;
+
+        auto previous_sigpipe = signal(SIGPIPE, SIG_IGN);
+        auto outcomes         = OrderedOutcomes(items, reporter);
+        auto order            = LongestFirst(ExpectedDurations(items));
+        auto next             = size_t{0};
+        auto workers          = std::vector<Worker>{};
+
+        auto dispatch = [&](Worker& worker) {
+            if (next == items.size())
+                return;
+            worker.current = order[next++];
+            worker.busy    = true;
+            worker.start   = std::chrono::steady_clock::now();
+            worker.timeout = options.timeout;
+            worker.file    = items[worker.current].test->File();
+            worker.line    = items[worker.current].test->Line();
+            // if the worker has died the write fails, its result pipe is closed and it is dealt with by poll
+            auto item = static_cast<uint64_t>(worker.current);
+            write_fully(worker.commands, &item, sizeof item);
+        };
+
+        for (auto i = 0U; i != jobs; ++i)
+        {
+            workers.push_back(start_worker(items, options, workers));
+        }
+        for (auto& worker : workers)
+        {
+            dispatch(worker);
+        }
+
+        auto restart = [&](Worker& worker) {
+            if (next != items.size())
+                worker = start_worker(items, options, workers);
+            dispatch(worker);
+        };
+
+        auto fds = std::vector<pollfd>{};
+        while (!outcomes.complete())
+        {
+            // wake up in time for the first time limit to run out
+            auto now  = std::chrono::steady_clock::now();
+            auto wait = -1;
+            fds.clear();
+            for (auto& worker : workers)
+            {
+                if (!worker.busy)
+                    continue;
+                fds.push_back(pollfd{worker.results, POLLIN, 0});
+                if (worker.timeout.count() != 0)
+                {
+                    auto left = std::chrono::duration_cast<std::chrono::milliseconds>(
+                                    worker.start + worker.timeout - now) +
+                                std::chrono::milliseconds(1);
+                    auto ms = static_cast<int>(std::max<std::chrono::milliseconds::rep>(0, left.count()));
+                    wait    = wait < 0 ? ms : std::min(wait, ms);
+                }
+            }
+            if (poll(fds.data(), static_cast<nfds_t>(fds.size()), wait) < 0)
+            {
+                if (errno == EINTR)
+                    continue;
+                throw std::runtime_error("Unable to wait for isolated test workers.");
+            }
+
+            for (auto& worker : workers)
+            {
+                auto ready = std::find_if(begin(fds), end(fds), [&](const pollfd& fd) {
+                    return worker.busy && fd.fd == worker.results && fd.revents != 0;
+                });
+                if (ready == end(fds))
+                    continue;
+
+                auto kind = uint32_t{0};
+                if (read_fully(worker.results, &kind, sizeof kind) && kind == TimeoutMessage)
+                {
+                    auto milliseconds = int64_t{0};
+                    auto line         = int32_t{0};
+                    auto size         = uint64_t{0};
+                    if (read_fully(worker.results, &milliseconds, sizeof milliseconds) &&
+                        read_fully(worker.results, &line, sizeof line) &&
+                        read_fully(worker.results, &size, sizeof size))
+                    {
+                        worker.file.resize(static_cast<size_t>(size));
+                        if (read_fully(worker.results, &worker.file[0], worker.file.size()))
+                        {
+                            worker.timeout = std::chrono::milliseconds(milliseconds);
+                            worker.line    = line;
+                            continue;
+                        }
+                    }
+                }
+
+                auto item    = uint64_t{0};
+                auto outcome = Outcome{};
+                if (kind == OutcomeMessage && read_outcome(worker.results, item, outcome))
+                {
+                    worker.busy = false;
+                    outcomes.add(static_cast<size_t>(item), std::move(outcome));
+                    dispatch(worker);
+                }
+                else
+                {
+                    auto crashed = worker.current;
+                    auto status  = 0;
+                    stop_worker(worker, status);
+                    outcome.error = Reporter::Error;
+                    outcome.msg   = describe_exit(status);
+                    outcomes.add(crashed, std::move(outcome));
+                    restart(worker);
+                }
+            }
+
+            now = std::chrono::steady_clock::now();
+            for (auto& worker : workers)
+            {
+                if (worker.busy && worker.timeout.count() != 0 && now - worker.start > worker.timeout)
+                {
+                    auto overrun = worker.current;
+                    auto outcome = TimeoutOutcome(worker.timeout, worker.file.c_str(), worker.line, now - worker.start);
+                    auto status  = 0;
+                    kill(worker.pid, SIGKILL);
+                    stop_worker(worker, status);
+                    outcomes.add(overrun, std::move(outcome));
+                    restart(worker);
+                }
+            }
+        }
+
+        for (auto& worker : workers)
+        {
+            auto status = 0;
+            if (worker.pid > 0)
+                stop_worker(worker, status);
+        }
+        signal(SIGPIPE, previous_sigpipe);
+    }
+#endif
+
+    // Puts the work items of each suite together, in the order the suites first appear, so a suite whose tests were
+    // registered apart (e.g. from more than one file) is run and reported in one piece.
+    void GroupBySuite(std::vector<WorkItem>& items)
+    {
+        auto first_seen = std::unordered_map<std::string, size_t>{};
+        auto rank       = std::vector<size_t>{};
+        rank.reserve(items.size());
+        for (auto& item : items)
+            rank.push_back(first_seen.emplace(item.test->Suite(), first_seen.size()).first->second);
+        if (std::is_sorted(begin(rank), end(rank)))
+            return;
+
+        auto order = std::vector<size_t>(items.size());
+        std::iota(begin(order), end(order), size_t{0});
+        std::stable_sort(begin(order), end(order), [&](size_t lhs, size_t rhs) { return rank[lhs] < rank[rhs]; });
+        auto grouped = std::vector<WorkItem>{};
+        grouped.reserve(items.size());
+        for (auto i : order)
+            grouped.push_back(items[i]);
+        items = std::move(grouped);
+    }
+
+    int MiniSuite::run_tests(const RunOptions& options, Reporter& reporter)
+    {
+        auto timings = TimingDatabase{};
+        if (!options.timings.empty())
+            timings.load(options.timings);
+
+        auto items = std::vector<WorkItem>{};
+        for (const Node* test = m_first; test != nullptr; test = test->Next())
+        {
+            if (!options.filter.empty() && !options.filter.matches(test->Suite(), test->BareName()))
+                continue;
+
+            auto num_tests = test->NumTests();
+            for (auto index = 0; index != num_tests; ++index)
+            {
+                items.push_back(WorkItem{test, index});
+                items.back().expected = timings.find(items.back());
+            }
+        }
+
+        GroupBySuite(items);
+        if (options.shard_count > 1)
+            items = SelectShard(items, options.shard_index, options.shard_count);
+        reporter.start_run(items.size());
+
+        auto jobs = static_cast<unsigned>(std::max<size_t>(1, std::min<size_t>(options.jobs, items.size())));
+        if (options.isolate)
+        {
+#if defined(TESTFRAMEWORK_HAS_FORK)
+            RunIsolated(items, jobs, options, reporter);
+#else
+            throw std::runtime_error("--isolate is not supported on this platform.");
+#endif
+        }
+        else
+        {
+            // even a single job runs on a thread of its own, with this one as the watchdog, as any test may set a
+            // TIMEOUT and then hang
+            RunParallel(items, jobs, options, reporter);
+        }
+
+        if (!options.timings_out.empty())
+        {
+            timings.record(items);
+            timings.save(options.timings_out);
+        }
+        return static_cast<int>(items.size());
+    }
+
+    // The time per iteration of each sample of a benchmark, in nanoseconds.
+    struct BenchmarkResult
+    {
+        std::string         name;
+        int64_t             iterations = 0;
+        std::vector<double> samples;
+        double              mean   = 0;
+        double              median = 0;
+        double              stddev = 0;
+        double              min    = 0;
+        PerfCounts          counts; // summed over the samples
+    };
+
+    void Summarise(BenchmarkResult& result)
+    {
+        auto sorted = result.samples;
+        auto n      = sorted.size();
+        std::sort(begin(sorted), end(sorted));
+        result.min    = sorted.front();
+        result.median = n % 2 != 0 ? sorted[n / 2] : (sorted[n / 2 - 1] + sorted[n / 2]) / 2;
+        result.mean   = std::accumulate(begin(sorted), end(sorted), 0.0) / n;
+
+        auto squares = 0.0;
+        for (auto sample : sorted)
+            squares += (sample - result.mean) * (sample - result.mean);
+        result.stddev = n > 1 ? std::sqrt(squares / (n - 1)) : 0.0;
+    }
+
+    // counts the hardware events of a benchmark's loop
+    class CountingListener : public BenchmarkListener
+    {
+    public:
+        explicit CountingListener(PerfCounters& counters) : m_counters(counters)
+        {
+        }
+
+        void loop_started() override
+        {
+            m_counters.start();
+        }
+
+        void loop_stopped() override
+        {
+            counts = m_counters.stop();
+        }
+
+        PerfCounts counts;
+
+    private:
+        PerfCounters& m_counters;
+    };
+
+    // runs `iterations` iterations of the benchmark, returning how long the loop took
+    std::chrono::nanoseconds TimeBenchmark(
+        const MiniSuite::Benchmark& benchmark, int64_t iterations, BenchmarkListener* listener = nullptr)
+    {
+        RecordingScope recording;
+        auto           state = BenchmarkState(iterations, listener);
+        benchmark.Run(state);
+
+        // a failed EXPECT_* fails the benchmark as an assertion would, once the loop is over
+        auto failures = recording.take();
+        if (!failures.empty())
+            throw failures.front();
+        if (!state.finished())
+            throw std::runtime_error("A BENCHMARK must loop until state.KeepRunning() returns false.");
+        return state.elapsed();
+    }
+
+    // Finds the number of iterations that take about `target`, growing by up to ten times each go.
+    int64_t CalibrateBenchmark(const MiniSuite::Benchmark& benchmark, std::chrono::nanoseconds target)
+    {
+        auto iterations = int64_t{1};
+        for (;;)
+        {
+            auto elapsed = TimeBenchmark(benchmark, iterations);
+            if (elapsed >= target || iterations >= 1000000000)
+                return iterations;
+
+            auto growth = elapsed.count() <= 0 ? 10.0 : std::min(10.0, 1.4 * target.count() / elapsed.count());
+            iterations  = std::max(iterations + 1, static_cast<int64_t>(iterations * growth));
+        }
+    }
+
+    BenchmarkResult RunBenchmark(const MiniSuite::Benchmark& benchmark, const RunOptions& options)
+    {
+        auto result       = BenchmarkResult{};
+        result.name       = std::string(benchmark.Suite()) + "." + benchmark.Name();
+        result.iterations = CalibrateBenchmark(benchmark, options.benchmark_time);
+        auto counters     = OpenPerfCounters(options.perf_counters);
+        for (auto sample = 0; sample != options.benchmark_samples; ++sample)
+        {
+            if (counters)
+            {
+                auto listener = CountingListener(*counters);
+                auto elapsed  = TimeBenchmark(benchmark, result.iterations, &listener);
+                result.samples.push_back(static_cast<double>(elapsed.count()) / result.iterations);
+                result.counts += listener.counts;
+            }
+            else
+            {
+                auto elapsed = TimeBenchmark(benchmark, result.iterations);
+                result.samples.push_back(static_cast<double>(elapsed.count()) / result.iterations);
+            }
+        }
+        Summarise(result);
+        return result;
+    }
+
+    // nanoseconds in the most readable unit
+    std::string FormatNanoseconds(double ns)
+    {
+        const char* units[] = {"ns", "us", "ms", "s"};
+        auto        unit    = size_t{0};
+        for (; unit != 3 && ns >= 1000.0; ++unit)
+            ns /= 1000.0;
+
+        std::stringstream s;
+        s << std::fixed << std::setprecision(ns < 10 ? 3 : ns < 100 ? 2 : 1) << ns << ' ' << units[unit];
+        return s.str();
+    }
+
+    // the hardware events per iteration, under the benchmark's timings
+    void PrintBenchmarkCounts(std::ostream& os, const BenchmarkResult& result)
+    {
+        auto iterations = static_cast<double>(result.iterations) * static_cast<double>(result.samples.size());
+        os << std::fixed << std::setprecision(2) << "    per iteration : cycles "
+           << result.counts.cycles / iterations << ", instructions " << result.counts.instructions / iterations
+           << ", IPC " << result.counts.ipc() << ", cache misses " << result.counts.cache_misses / iterations
+           << ", branch misses " << result.counts.branch_misses / iterations << '\n';
+        os.unsetf(std::ios::fixed);
+        os << std::setprecision(6);
+    }
+
+    // A text file with a line for each benchmark, its name then its samples separated by tabs.
+    void SaveBenchmarks(const std::string& filename, const std::vector<BenchmarkResult>& results)
+    {
+        std::ofstream file(filename);
+        if (!file)
+            throw std::runtime_error("Can not write the benchmarks to " + filename + ".");
+
+        file << std::setprecision(17);
+        for (auto& result : results)
+        {
+            file << result.name;
+            for (auto sample : result.samples)
+                file << '\t' << sample;
+            file << '\n';
+        }
+    }
+
+    std::map<std::string, std::vector<double>> LoadBenchmarks(const std::string& filename)
+    {
+        std::ifstream file(filename);
+        if (!file)
+            throw std::runtime_error("Can not read the benchmark baseline " + filename + ".");
+
+        auto benchmarks = std::map<std::string, std::vector<double>>{};
+        for (auto line = std::string{}; std::getline(file, line);)
+        {
+            auto tab = line.find('\t');
+            if (tab == std::string::npos)
+                continue;
+
+            auto& samples = benchmarks[line.substr(0, tab)];
+            auto  values  = std::stringstream(line.substr(tab + 1));
+            for (auto sample = 0.0; values >> sample;)
+                samples.push_back(sample);
+        }
+        return benchmarks;
+    }
+
+    // The two sided p-value of the Mann-Whitney U test that `a` and `b` come from the same distribution, using the
+    // normal approximation with a correction for ties. It makes no assumption about the shape of the distributions,
+    // which for timings are anything but normal.
+    double MannWhitneyP(const std::vector<double>& a, const std::vector<double>& b)
+    {
+        auto all = std::vector<std::pair<double, bool>>{};
+        for (auto sample : a)
+            all.emplace_back(sample, true);
+        for (auto sample : b)
+            all.emplace_back(sample, false);
+        std::sort(begin(all), end(all));
+
+        // tied samples share the average of their ranks
+        auto rank_sum = 0.0;
+        auto ties     = 0.0;
+        for (auto first = size_t{0}; first != all.size();)
+        {
+            auto last = first;
+            while (last != all.size() && all[last].first == all[first].first)
+                ++last;
+            auto tied = static_cast<double>(last - first);
+            auto rank = (first + 1 + last) / 2.0;
+            for (auto i = first; i != last; ++i)
+            {
+                if (all[i].second)
+                    rank_sum += rank;
+            }
+            ties += tied * tied * tied - tied;
+            first = last;
+        }
+
+        auto n1       = static_cast<double>(a.size());
+        auto n2       = static_cast<double>(b.size());
+        auto n        = n1 + n2;
+        auto u        = rank_sum - n1 * (n1 + 1) / 2;
+        auto variance = n1 * n2 / 12 * ((n + 1) - ties / (n * (n - 1)));
+        if (variance <= 0)
+            return 1.0;
+
+        auto z = (std::abs(u - n1 * n2 / 2) - 0.5) / std::sqrt(variance);
+        return std::min(1.0, std::erfc(std::max(z, 0.0) / std::sqrt(2.0)));
+    }
+
+    // Compares the samples with the baseline, returning the number of significant regressions.
+    int CompareBenchmarks(std::ostream& os, const std::string& filename, const std::vector<BenchmarkResult>& results,
+        double threshold, size_t width)
+    {
+        const auto significance = 0.05;
+
+        auto baseline    = LoadBenchmarks(filename);
+        auto regressions = 0;
+        print(os, "\nCompared with ", filename, " :-\n");
+        for (auto& result : results)
+        {
+            os << std::left << std::setw(static_cast<int>(width)) << result.name << std::right;
+            auto old = baseline.find(result.name);
+            if (old == baseline.end() || old->second.empty())
+            {
+                os << "  not in the baseline\n";
+                continue;
+            }
+
+            auto before    = BenchmarkResult{};
+            before.samples = old->second;
+            Summarise(before);
+
+            auto change  = 100.0 * (result.median / before.median - 1.0);
+            auto p       = MannWhitneyP(result.samples, old->second);
+            auto verdict = p >= significance ? "unchanged" : change > 0 ? "slower" : "faster";
+            os << std::showpos << std::fixed << std::setprecision(1) << std::setw(9) << change << '%'
+               << std::noshowpos << "  " << verdict << " (" << std::setprecision(1) << 100.0 * (1.0 - p)
+               << "% confidence)";
+            if (p < significance && change > threshold)
+            {
+                ++regressions;
+                os << " REGRESSION";
+            }
+            os << '\n';
+            os.unsetf(std::ios::fixed);
+        }
+        print(os, regressions, " Regressions.\n");
+        return regressions;
+    }
+
+    // Benchmarks are run one at a time on this thread, so they are not timed while competing with each other.
+    int MiniSuite::run_benchmarks(const RunOptions& options, std::ostream& os)
+    {
+        auto benchmarks = std::vector<const Benchmark*>{};
+        auto width      = size_t{9};
+        for (auto benchmark = m_first_benchmark; benchmark != nullptr; benchmark = benchmark->m_next)
+        {
+            if (!options.filter.empty() && !options.filter.matches(benchmark->Suite(), benchmark->Name()))
+                continue;
+            benchmarks.push_back(benchmark);
+            width = std::max(width, std::strlen(benchmark->Suite()) + 1 + std::strlen(benchmark->Name()));
+        }
+
+        os << std::left << std::setw(static_cast<int>(width)) << "Benchmark" << std::right << std::setw(14)
+           << "Iterations" << std::setw(12) << "Mean" << std::setw(12) << "Median" << std::setw(12) << "StdDev"
+           << std::setw(12) << "Min" << '\n';
+
+        auto failures = 0;
+        auto results  = std::vector<BenchmarkResult>{};
+        for (auto benchmark : benchmarks)
+        {
+            try
+            {
+                results.push_back(RunBenchmark(*benchmark, options));
+                auto& result = results.back();
+                os << std::left << std::setw(static_cast<int>(width)) << result.name << std::right << std::setw(14)
+                   << result.iterations << std::setw(12) << FormatNanoseconds(result.mean) << std::setw(12)
+                   << FormatNanoseconds(result.median) << std::setw(12) << FormatNanoseconds(result.stddev)
+                   << std::setw(12) << FormatNanoseconds(result.min) << '\n';
+                if (result.counts.valid)
+                    PrintBenchmarkCounts(os, result);
+            }
+            catch (const std::exception& e)
+            {
+                ++failures;
+                auto name = std::string(benchmark->Suite()) + "." + benchmark->Name();
+                os << std::left << std::setw(static_cast<int>(width)) << name << " failed : " << e.what() << '\n';
+            }
+        }
+        print(os, "\n", benchmarks.size(), " Benchmarks.\n", failures, " Failures.\n");
+
+        // compared first so a run can be compared with the file it replaces
+        if (!options.benchmark_baseline.empty())
+            failures += CompareBenchmarks(os, options.benchmark_baseline, results, options.benchmark_threshold, width);
+        if (!options.benchmark_save.empty())
+            SaveBenchmarks(options.benchmark_save, results);
+        return failures;
+    }
+
+    MiniSuite& MiniSuite::Instance()
+    {
+        static UnitTests::MiniSuite runner;
+        return runner;
+    }
+
+    const PropertySettings& CurrentPropertySettings()
+    {
+        return current_properties;
+    }
+
+    std::string FormatError(std::string file, int line, int error)
+    {
+        auto msg(std::move(file));
+        msg += "(" + std::to_string(line) + ")";
+        msg += " : error A" + std::to_string(error) + ": ";
+        return msg;
+    }
+} // namespace UnitTests
+
+// With TEST_ALLOCATION_HOOKS defined where testmain.inl is included, the global operator new and delete are replaced
+// to count the allocations made on each thread, for ASSERT_MAX_ALLOCATIONS, --allocations and --detect-leaks. They
+// are left alone otherwise, so a replacement of your own (or an allocator such as tcmalloc) still links.
+#if defined(TEST_ALLOCATION_HOOKS)
+namespace UnitTests
+{
+    namespace allocation_hooks
+    {
+        // constant initialised, so they can be used by the first allocation a thread makes
+        thread_local AllocationCounts counts;
+        thread_local uint64_t         leak_check = 0;
+
+        // the number of threads checking for leaks, when there are none a free need not look for a tracked block
+        std::atomic<int>      checking_threads{0};
+        std::atomic<uint64_t> last_leak_check{0};
+
+        // the tracker's own memory comes from malloc, so it is not counted or tracked itself
+        template <class T>
+        struct MallocAllocator
+        {
+            using value_type = T;
+
+            MallocAllocator() = default;
+
+            template <class U>
+            MallocAllocator(const MallocAllocator<U>&)
+            {
+            }
+
+            T* allocate(std::size_t n)
+            {
+                if (auto p = std::malloc(n * sizeof(T)))
+                    return static_cast<T*>(p);
+                throw std::bad_alloc();
+            }
+
+            void deallocate(T* p, std::size_t)
+            {
+                std::free(p);
+            }
+
+            template <class U>
+            bool operator==(const MallocAllocator<U>&) const
+            {
+                return true;
+            }
+
+            template <class U>
+            bool operator!=(const MallocAllocator<U>&) const
+            {
+                return false;
+            }
+        };
+
+        // the size of each block allocated during a leak check and the check it belongs to
+        struct TrackedBlocks
+        {
+            struct Block
+            {
+                std::size_t size;
+                uint64_t    check;
+            };
+
+            using allocator = MallocAllocator<std::pair<void* const, Block>>;
+
+            std::mutex mutex;
+            std::unordered_map<void*, Block, std::hash<void*>, std::equal_to<void*>, allocator> blocks;
+        };
+
+        inline TrackedBlocks& tracked()
+        {
+            static TrackedBlocks tracked_blocks;
+            return tracked_blocks;
+        }
+
+        inline void track(void* p, std::size_t size) noexcept
+        {
+            auto& t = tracked();
+            try
+            {
+                std::lock_guard<std::mutex> lock(t.mutex);
+                t.blocks[p] = TrackedBlocks::Block{size, leak_check};
+            }
+            catch (...)
+            {
+                // out of memory to track it in, the block is not checked
+            }
+        }
+
+        inline void untrack(void* p) noexcept
+        {
+            auto&                       t = tracked();
+            std::lock_guard<std::mutex> lock(t.mutex);
+            t.blocks.erase(p);
+        }
+
+        inline void* allocate(std::size_t size) noexcept
+        {
+            auto p = std::malloc(size == 0 ? 1 : size);
+            if (p)
+            {
+                ++counts.allocations;
+                counts.bytes += size;
+                if (leak_check != 0)
+                    track(p, size);
+            }
+            return p;
+        }
+
+        inline void* allocate_or_throw(std::size_t size)
+        {
+            for (;;)
+            {
+                if (auto p = allocate(size))
+                    return p;
+                auto handler = std::get_new_handler();
+                if (!handler)
+                    throw std::bad_alloc();
+                handler();
+            }
+        }
+
+        inline void deallocate(void* p) noexcept
+        {
+            if (p)
+            {
+                ++counts.deallocations;
+                if (checking_threads != 0)
+                    untrack(p);
+                std::free(p);
+            }
+        }
+    } // namespace allocation_hooks
+
+    uint64_t StartLeakCheck()
+    {
+        using namespace allocation_hooks;
+        ++checking_threads;
+        auto previous = leak_check;
+        leak_check    = ++last_leak_check;
+        return previous;
+    }
+
+    LeakCounts StopLeakCheck(uint64_t previous)
+    {
+        using namespace allocation_hooks;
+        auto check = leak_check;
+        leak_check = previous;
+
+        // the blocks left are forgotten, if the check is nested they are not the outer check's
+        auto  leaks = LeakCounts{};
+        auto& t     = tracked();
+        {
+            std::lock_guard<std::mutex> lock(t.mutex);
+            for (auto block = t.blocks.begin(); block != t.blocks.end();)
+            {
+                if (block->second.check != check)
+                {
+                    ++block;
+                    continue;
+                }
+                ++leaks.blocks;
+                leaks.bytes += block->second.size;
+                if (leaks.num_sizes != LeakCounts::max_sizes)
+                    leaks.sizes[leaks.num_sizes++] = block->second.size;
+                else
+                {
+                    // the sample is of the biggest blocks
+                    auto smallest = std::min_element(leaks.sizes, leaks.sizes + leaks.num_sizes);
+                    *smallest     = std::max<uint64_t>(*smallest, block->second.size);
+                }
+                block = t.blocks.erase(block);
+            }
+        }
+        --checking_threads;
+        std::sort(leaks.sizes, leaks.sizes + leaks.num_sizes, std::greater<uint64_t>());
+        return leaks;
+    }
+
+    AllocationCounts ThreadAllocations()
+    {
+        return allocation_hooks::counts;
+    }
+
+    bool AllocationHooksInstalled()
+    {
+        return true;
+    }
+} // namespace UnitTests
+
+void* operator new(std::size_t size)
+{
+    return UnitTests::allocation_hooks::allocate_or_throw(size);
+}
+
+void* operator new[](std::size_t size)
+{
+    return UnitTests::allocation_hooks::allocate_or_throw(size);
+}
+
+void* operator new(std::size_t size, const std::nothrow_t&) noexcept
+{
+    try
+    {
+        return UnitTests::allocation_hooks::allocate_or_throw(size);
+    }
+    catch (...)
+    {
+        return nullptr;
+    }
+}
+
+void* operator new[](std::size_t size, const std::nothrow_t&) noexcept
+{
+    return operator new(size, std::nothrow);
+}
+
+void operator delete(void* p) noexcept
+{
+    UnitTests::allocation_hooks::deallocate(p);
+}
+
+void operator delete[](void* p) noexcept
+{
+    UnitTests::allocation_hooks::deallocate(p);
+}
+
+void operator delete(void* p, const std::nothrow_t&) noexcept
+{
+    UnitTests::allocation_hooks::deallocate(p);
+}
+
+void operator delete[](void* p, const std::nothrow_t&) noexcept
+{
+    UnitTests::allocation_hooks::deallocate(p);
+}
+
+void operator delete(void* p, std::size_t) noexcept
+{
+    UnitTests::allocation_hooks::deallocate(p);
+}
+
+void operator delete[](void* p, std::size_t) noexcept
+{
+    UnitTests::allocation_hooks::deallocate(p);
+}
+#else
+namespace UnitTests
+{
+    AllocationCounts ThreadAllocations()
+    {
+        return AllocationCounts{};
+    }
+
+    bool AllocationHooksInstalled()
+    {
+        return false;
+    }
+
+    uint64_t StartLeakCheck()
+    {
+        return 0;
+    }
+
+    LeakCounts StopLeakCheck(uint64_t)
+    {
+        return LeakCounts{};
+    }
+} // namespace UnitTests
+#endif
+
+// a fuzz target gets its main from libFuzzer
+#if !defined(TEST_FUZZ_MAIN)
 int main(int argc, char** argv)
 {
     try
     {
         auto end_argv = std::next(argv, argc);
         auto args     = std::vector<std::string>(argv, end_argv);
-        return UnitTests::MiniSuite::Instance().RunTests(args, std::cout);
+        auto failures = UnitTests::MiniSuite::Instance().RunTests(args, std::cout);
+        if (UnitTests::abandoned_threads != 0)
+        {
+            // a hung test is still running, so the tests must not be destroyed on the way out
+            std::cout.flush();
+            std::fflush(nullptr);
+            std::_Exit(failures);
+        }
+        return failures;
     }
     catch (std::exception& e)
     {
@@ -417,3 +3268,4 @@ int main(int argc, char** argv)
         return -1;
     }
 } /**/
+#endif
@@ -0,0 +1,143 @@
+#include "testframework/MiniTestFramework.h"
+
+#include <memory>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace std::literals;
+
+namespace
+{
+    const char* test_suite = "allocation_tests";
+
+    std::string run(UnitTests::MiniSuite& suite, std::vector<std::string> args)
+    {
+        auto os = std::ostringstream{};
+        args.insert(begin(args), "");
+        suite.RunTests(args, os);
+        return os.str();
+    }
+
+    TEST(code_that_does_not_allocate_passes)
+    {
+        auto numbers = std::vector<int>(100);
+        ASSERT_MAX_ALLOCATIONS(0, numbers.assign(100, 7));
+        ASSERT_MAX_ALLOCATIONS(1, auto copy = numbers; UnitTests::DoNotOptimize(copy));
+    }
+
+    // it is a single statement, so it can be the body of an if with an else
+    TEST(the_check_is_one_statement)
+    {
+        auto numbers = std::vector<int>(10);
+        if (numbers.empty())
+            ASSERT_MAX_ALLOCATIONS(0, numbers.clear());
+        else
+            ASSERT_MAX_ALLOCATIONS(0, numbers.assign(10, 1));
+        ASSERT_EQUALS(1, numbers[9]);
+    }
+
+    TEST(too_many_allocations_fail)
+    {
+        auto message = std::string{};
+        try
+        {
+            ASSERT_MAX_ALLOCATIONS(1, auto a = std::make_unique<int>(1); auto b = std::make_unique<int>(2));
+        }
+        catch (const UnitTests::TestFailure& e)
+        {
+            message = e.what();
+        }
+        ASSERT_IN("Expected at most 1 allocations from auto a = std::make_unique<int>(1); auto b"s, message);
+        ASSERT_IN("but it made 2 ("s, message);
+    }
+
+    TEST(allocations_and_bytes_are_counted_on_this_thread)
+    {
+        if (!UnitTests::AllocationHooksInstalled())
+            SKIP();
+
+        auto before = UnitTests::ThreadAllocations();
+        auto p      = new char[100];
+        UnitTests::DoNotOptimize(p);
+        delete[] p;
+        auto made = UnitTests::ThreadAllocations() - before;
+        ASSERT_EQUALS(1U, made.allocations);
+        ASSERT_EQUALS(100U, made.bytes);
+        ASSERT_EQUALS(1U, made.deallocations);
+    }
+
+    void check_reported(std::vector<std::string> args)
+    {
+        if (!UnitTests::AllocationHooksInstalled())
+            SKIP();
+
+        auto suite = UnitTests::MiniSuite{};
+        suite.AddTest(
+            [] {
+                auto numbers = std::vector<int>(10);
+                UnitTests::DoNotOptimize(numbers);
+            },
+            "allocations", "ten_ints", __FILE__, __LINE__);
+
+        args.insert(end(args), {"-v", "--allocations"});
+        ASSERT_IN("ms) allocations=1 allocated-bytes="s + std::to_string(10 * sizeof(int)) + "\n", run(suite, args));
+    }
+
+    TEST(allocations_are_reported_for_each_test)
+    {
+        check_reported({});
+        check_reported({"--jobs", "2"});
+#if !defined(_WIN32)
+        check_reported({"--isolate"});
+#endif
+    }
+
+    // kept out of the tests' sight so they leak, and freed afterwards
+    char* leaked[2] = {};
+
+    void check_leaks(std::vector<std::string> args)
+    {
+        if (!UnitTests::AllocationHooksInstalled())
+            SKIP();
+
+        auto suite = UnitTests::MiniSuite{};
+        suite.AddTest(
+            [] {
+                leaked[0] = new char[8];
+                leaked[1] = new char[24];
+            },
+            "leaks", "leaky", __FILE__, __LINE__);
+        suite.AddTest(
+            [] {
+                auto numbers = std::vector<int>(100);
+                UnitTests::DoNotOptimize(numbers);
+            },
+            "leaks", "tidy", __FILE__, __LINE__);
+        suite.AddTest(
+            [] {
+                auto p = new int(1);
+                std::thread([p] { delete p; }).join();
+            },
+            "leaks", "freed_on_another_thread", __FILE__, __LINE__);
+
+        args.push_back("--detect-leaks");
+        auto report = run(suite, args);
+        delete[] leaked[0];
+        delete[] leaked[1];
+        leaked[0] = leaked[1] = nullptr;
+
+        ASSERT_IN(" : error A1004: Memory leak : Test leaked 2 blocks (32 bytes) of sizes 24, 8 while testing "
+                  "TEST(leaky"s,
+            report);
+        ASSERT_IN("3 Tests.\n0 Skipped.\n1 Failures.\n0 Errors."s, report);
+    }
+
+    // not with --isolate, TSAN won't have a forked worker start a thread while the tests run on several threads
+    TEST(leaks_are_reported_with_their_sizes)
+    {
+        check_leaks({});
+        check_leaks({"--jobs", "2"});
+    }
+} // namespace
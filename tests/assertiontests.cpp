@@ -388,6 +388,28 @@ namespace
         }
     }
 
+    TEST(expect_records_the_failure_and_returns)
+    {
+        auto& recorded = UnitTests::RecordedFailures();
+        ASSERT_TRUE(recorded.empty());
+
+        EXPECT_EQUALS(1, 1);
+        EXPECT_NOT_IN("needle"s, "haystack"s);
+        ASSERT_TRUE(recorded.empty());
+
+        std::vector<int> v{0, 1, 2, 3};
+        std::list<int>   li{0, 1};
+        EXPECT_NOT_EQUALS(1, 1);
+        EXPECT_RANGE_EQUALS(li, v);
+        auto failures = std::move(recorded);
+        recorded.clear();
+
+        ASSERT_EQUALS(2U, failures.size());
+        ASSERT_IN("Wasn't expecting to get <1>"s, std::string(failures[0].what()));
+        ASSERT_IN("Expected range [2] different length to actual range [4]"s, std::string(failures[1].what()));
+        ASSERT_IN(std::string(__FILE__), std::string(failures[1].what()));
+    }
+
     TEST(assert_range_equals_msg)
     {
         try
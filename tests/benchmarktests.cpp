@@ -0,0 +1,174 @@
+#include "testframework/MiniTestFramework.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <numeric>
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+using namespace std::literals;
+
+namespace
+{
+    const char* test_suite = "benchmark_tests";
+
+    BENCHMARK(sort_1000)
+    {
+        auto data = std::vector<int>(1000);
+        std::iota(data.rbegin(), data.rend(), 0);
+        while (state.KeepRunning())
+        {
+            auto copy = data;
+            std::sort(begin(copy), end(copy));
+            UnitTests::DoNotOptimize(copy);
+        }
+    }
+
+    std::string run(UnitTests::MiniSuite& suite, std::vector<std::string> args)
+    {
+        auto os = std::ostringstream{};
+        args.insert(begin(args), "");
+        suite.RunTests(args, os);
+        return os.str();
+    }
+
+    void count_to_100(UnitTests::BenchmarkState& state)
+    {
+        while (state.KeepRunning())
+        {
+            for (auto i = 0; i != 100; ++i)
+                UnitTests::DoNotOptimize(i);
+        }
+    }
+
+    void leaves_early(UnitTests::BenchmarkState& state)
+    {
+        while (state.KeepRunning())
+            break;
+    }
+
+    TEST(benchmarks_are_calibrated_and_summarised)
+    {
+        UnitTests::MiniSuite::Benchmark benchmark("benchmarks", "count_to_100", __FILE__, __LINE__, count_to_100);
+        auto                            suite = UnitTests::MiniSuite{};
+        suite.AddBenchmark(benchmark);
+        suite.AddTest([] { FAIL("tests are not run"); }, "benchmarks", "test", __FILE__, __LINE__);
+
+        auto report = run(suite, {"--benchmark", "--benchmark-time", "1", "--benchmark-samples", "3"});
+        ASSERT_IN("Benchmark"s, report);
+        ASSERT_IN("Median"s, report);
+        ASSERT_IN("benchmarks.count_to_100"s, report);
+        ASSERT_IN("1 Benchmarks.\n0 Failures."s, report);
+
+        // a 1ms target needs more than one iteration of something this quick, even on a loaded or sanitized build
+        auto line       = report.substr(report.find("benchmarks.count_to_100"));
+        auto iterations = std::stoll(line.substr(std::string("benchmarks.count_to_100").size()));
+        ASSERT_TRUE(iterations > 1);
+    }
+
+    TEST(perf_counters_are_shown_per_iteration)
+    {
+        UnitTests::MiniSuite::Benchmark benchmark("benchmarks", "count_to_100", __FILE__, __LINE__, count_to_100);
+        auto                            suite = UnitTests::MiniSuite{};
+        suite.AddBenchmark(benchmark);
+
+        auto report =
+            run(suite, {"--benchmark", "--perf-counters", "--benchmark-time", "1", "--benchmark-samples", "3"});
+        ASSERT_IN("1 Benchmarks.\n0 Failures."s, report);
+        if (report.find("Hardware performance counters are not available") == std::string::npos)
+            ASSERT_IN("    per iteration : cycles "s, report);
+        else
+            ASSERT_NOT_IN("per iteration"s, report);
+    }
+
+    TEST(benchmarks_must_finish_their_loop)
+    {
+        UnitTests::MiniSuite::Benchmark benchmark("benchmarks", "leaves_early", __FILE__, __LINE__, leaves_early);
+        auto                            suite = UnitTests::MiniSuite{};
+        suite.AddBenchmark(benchmark);
+
+        auto report = run(suite, {"--benchmark", "--benchmark-time", "1"});
+        ASSERT_IN("benchmarks.leaves_early failed : A BENCHMARK must loop"s, report);
+        ASSERT_IN("1 Failures."s, report);
+    }
+
+    void expects_too_much(UnitTests::BenchmarkState& state)
+    {
+        auto count = 0;
+        while (state.KeepRunning())
+            UnitTests::DoNotOptimize(++count);
+        EXPECT_EQUALS(-1, count);
+        EXPECT_TRUE("reached", false);
+    }
+
+    TEST(benchmarks_fail_on_a_failed_expect)
+    {
+        UnitTests::MiniSuite::Benchmark benchmark("benchmarks", "expects", __FILE__, __LINE__, expects_too_much);
+        auto                            suite = UnitTests::MiniSuite{};
+        suite.AddBenchmark(benchmark);
+
+        auto report = run(suite, {"--benchmark", "--benchmark-time", "1"});
+        ASSERT_IN("benchmarks.expects failed : "s, report);
+        ASSERT_IN("Expected <-1>"s, report);
+        ASSERT_IN("1 Benchmarks.\n1 Failures."s, report);
+        ASSERT_TRUE(UnitTests::RecordedFailures().empty());
+    }
+
+    // runs count_to_100 against a baseline where each sample took `ns`, returning the report and the failure count
+    std::pair<std::string, int> compare_with(const char* ns)
+    {
+        auto baseline = "benchmark_tests_baseline.txt"s;
+        {
+            std::ofstream file(baseline);
+            file << "benchmarks.count_to_100";
+            for (auto i = 0; i != 5; ++i)
+                file << '\t' << ns;
+            file << "\nbenchmarks.removed\t1\n";
+        }
+
+        UnitTests::MiniSuite::Benchmark benchmark("benchmarks", "count_to_100", __FILE__, __LINE__, count_to_100);
+        auto                            suite = UnitTests::MiniSuite{};
+        suite.AddBenchmark(benchmark);
+
+        auto os       = std::ostringstream{};
+        auto failures = suite.RunTests({"", "--benchmark", "--benchmark-time", "1", "--benchmark-samples", "5",
+                                           "--benchmark-baseline", baseline, "--benchmark-save", baseline},
+            os);
+        std::remove(baseline.c_str());
+        return {os.str(), failures};
+    }
+
+    TEST(significant_regressions_fail_the_run)
+    {
+        auto slower = compare_with("0.001");
+        ASSERT_IN("slower (99."s, slower.first);
+        ASSERT_IN("REGRESSION\n1 Regressions."s, slower.first);
+        ASSERT_EQUALS(1, slower.second);
+
+        auto faster = compare_with("1e9");
+        ASSERT_IN("faster (99."s, faster.first);
+        ASSERT_IN("0 Regressions."s, faster.first);
+        ASSERT_EQUALS(0, faster.second);
+    }
+
+    TEST(benchmark_threshold_must_not_be_negative)
+    {
+        ASSERT_THROWS_WITH_MESSAGE(std::runtime_error, "can not be negative",
+            run(UnitTests::MiniSuite::Instance(), {"--benchmark", "--benchmark-threshold", "-1"}));
+    }
+
+    TEST(benchmark_state_counts_the_iterations)
+    {
+        auto state = UnitTests::BenchmarkState(3);
+        auto loops = 0;
+        while (state.KeepRunning())
+            ++loops;
+        ASSERT_EQUALS(3, loops);
+        ASSERT_TRUE(state.finished());
+        ASSERT_THROWS_WITH_MESSAGE(std::runtime_error, "at least 1",
+            run(UnitTests::MiniSuite::Instance(), {"--benchmark", "--benchmark-samples", "0"}));
+    }
+} // namespace
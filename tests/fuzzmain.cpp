@@ -0,0 +1,2 @@
+#define TEST_FUZZ_MAIN
+#include "testframework/fuzz.h"
@@ -0,0 +1,81 @@
+#include "testframework/MiniTestFramework.h"
+#include "testframework/fuzz.h"
+#include "testframework/streamfortestoutput.h"
+
+#include <cstdint>
+#include <string>
+#include <tuple>
+#include <vector>
+
+using namespace std::literals;
+
+namespace
+{
+    const char* test_suite = "fuzz_tests";
+
+    FUZZ_TEST(escapes_round_trip, std::string)
+    {
+        auto s = std::get<0>(args);
+        UnitTests::add_escapes(s);
+        UnitTests::remove_escapes(s);
+        ASSERT_EQUALS(std::get<0>(args), s);
+    }
+
+    FUZZ_TEST(escaped_strings_have_no_control_characters, std::string)
+    {
+        auto s = std::get<0>(args);
+        UnitTests::add_escapes(s);
+        ASSERT_EQUALS(std::string::npos, s.find_first_of("\n\t\r\v"));
+    }
+
+    template <class T>
+    T decode(const std::vector<uint8_t>& bytes)
+    {
+        auto input = UnitTests::FuzzInput(bytes.data(), bytes.size());
+        return input.consume<T>();
+    }
+
+    TEST(numbers_are_decoded_little_endian_and_zero_padded)
+    {
+        ASSERT_EQUALS(0x0201, decode<uint16_t>({1, 2, 3}));
+        ASSERT_EQUALS(0x03u, decode<uint32_t>({3}));
+        ASSERT_EQUALS(0, decode<int>({}));
+        ASSERT_TRUE(decode<bool>({3}));
+    }
+
+    TEST(strings_end_at_an_escaped_character)
+    {
+        ASSERT_EQUALS("ab"s, decode<std::string>({'a', 'b', '\\', 'x', 'c'}));
+        ASSERT_EQUALS("a\\b"s, decode<std::string>({'a', '\\', '\\', 'b'}));
+        ASSERT_EQUALS("a\\"s, decode<std::string>({'a', '\\'}));
+
+        auto args = decode<std::tuple<std::string, char>>({'a', '\\', 'x', 'c'});
+        ASSERT_EQUALS("a"s, std::get<0>(args));
+        ASSERT_EQUALS('c', std::get<1>(args));
+    }
+
+    TEST(vectors_are_limited_by_the_input)
+    {
+        ASSERT_EQUALS((std::vector<uint8_t>{7, 8}), decode<std::vector<uint8_t>>({2, 0, 7, 8, 9}));
+        ASSERT_EQUALS((std::vector<uint8_t>{7, 8}), decode<std::vector<uint8_t>>({0xff, 0xff, 7, 8}));
+    }
+
+    struct expects_no_a
+    {
+        using args_type = std::tuple<std::string>;
+        void operator()(const args_type& args) const
+        {
+            EXPECT_NOT_IN("a"s, std::get<0>(args));
+            EXPECT_NOT_IN("b"s, std::get<0>(args));
+        }
+    };
+
+    TEST(a_failed_expect_is_thrown_once_the_input_has_run)
+    {
+        const uint8_t ab[] = {'a', 'b'};
+        ASSERT_THROWS_WITH_MESSAGE(
+            std::runtime_error, "find \"b\"", UnitTests::FuzzTest<expects_no_a>::run(ab, sizeof ab));
+        ASSERT_NO_THROW(UnitTests::FuzzTest<expects_no_a>::run(ab, 0));
+        ASSERT_TRUE(UnitTests::RecordedFailures().empty());
+    }
+} // namespace
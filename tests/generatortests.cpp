@@ -0,0 +1,86 @@
+#include "testframework/MiniTestFramework.h"
+#include "testframework/generators.h"
+
+#include <atomic>
+#include <sstream>
+#include <string>
+#include <tuple>
+#include <vector>
+
+using namespace std::literals;
+
+namespace
+{
+    const char* test_suite = "generator_tests";
+
+    TEST(range_counts_up_to_last)
+    {
+        ASSERT_EQUALS((std::vector<int>{2, 3, 4}), (std::vector<int>(UnitTests::range(2, 5).begin(),
+                                                       UnitTests::range(2, 5).end())));
+        auto evens = UnitTests::range(0, 9, 2);
+        ASSERT_EQUALS(5u, evens.size());
+        ASSERT_EQUALS(8, evens[4]);
+        ASSERT_EQUALS(0u, UnitTests::range(5, 5).size());
+    }
+
+    TEST(range_counts_down_with_a_negative_step)
+    {
+        auto down = UnitTests::range(10, 0, -3);
+        ASSERT_EQUALS(4u, down.size());
+        ASSERT_EQUALS(1, down[3]);
+        ASSERT_THROWS(std::invalid_argument, UnitTests::range(0, 10, 0));
+    }
+
+    TEST(generate_calls_the_function_with_the_index)
+    {
+        auto squares = UnitTests::generate(4, [](size_t i) { return i * i; });
+        ASSERT_EQUALS(4u, squares.size());
+        ASSERT_EQUALS(9u, squares[3]);
+        ASSERT_EQUALS(4u, *(squares.begin() + 2));
+    }
+
+    TEST(cartesian_varies_the_last_list_fastest)
+    {
+        const char* names[] = {"a", "b"};
+        auto        pairs   = UnitTests::cartesian(names, std::vector<int>{1, 2, 3});
+        ASSERT_EQUALS(6u, pairs.size());
+        ASSERT_EQUALS("a"s, std::get<0>(pairs[0]));
+        ASSERT_EQUALS(3, std::get<1>(pairs[2]));
+        ASSERT_EQUALS("b"s, std::get<0>(pairs[3]));
+        ASSERT_EQUALS(1, std::get<1>(pairs[3]));
+        ASSERT_EQUALS(0u, UnitTests::cartesian(names, std::vector<int>{}).size());
+    }
+
+    // only the parameters that are run are made
+    TEST(a_filtered_generator_test_only_makes_the_selected_parameters)
+    {
+        std::atomic<int> made{0};
+        auto             suite = UnitTests::MiniSuite{};
+        suite.AddParamTest(UnitTests::generate(100000,
+                               [&made](size_t i) {
+                                   ++made;
+                                   return i;
+                               }),
+            [](size_t) {}, "generators", "million", __FILE__, __LINE__);
+        suite.AddTest([] {}, "generators", "other", __FILE__, __LINE__);
+
+        auto os = std::ostringstream{};
+        suite.RunTests({"", "--filter", "*.other"}, os);
+        ASSERT_EQUALS(0, made.load());
+        suite.RunTests({"", "--shard-count", "10000", "--shard-index", "7"}, os);
+        ASSERT_TRUE(made.load() < 100);
+    }
+
+    const int sizes[] = {1, 2, 4};
+
+    PARAM_TEST(generated_params_run_as_tests, UnitTests::cartesian(sizes, UnitTests::range(0, 3)))
+    {
+        ASSERT_TRUE(std::get<1>(args) < 3);
+        ASSERT_TRUE(std::get<0>(args) > 0);
+    }
+
+    PARAM_TEST_VIEW(a_static_table_is_used_in_place, sizes)
+    {
+        ASSERT_TRUE(&args >= sizes && &args < sizes + 3);
+    }
+} // namespace
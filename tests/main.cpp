@@ -1,2 +1,3 @@
-#define TEST_MAIN
-#include "testframework/MiniTestFramework.h"
+#define TEST_MAIN
+#define TEST_ALLOCATION_HOOKS
+#include "testframework/MiniTestFramework.h"
@@ -0,0 +1,107 @@
+#include "testframework/MiniTestFramework.h"
+#include "testframework/property.h"
+
+#include <algorithm>
+#include <sstream>
+#include <string>
+#include <tuple>
+#include <vector>
+
+using namespace std::literals;
+
+namespace
+{
+    const char* test_suite = "property_tests";
+
+    PROPERTY_TEST(reversing_twice_changes_nothing, std::vector<int>)
+    {
+        auto v = std::get<0>(args);
+        std::reverse(begin(v), end(v));
+        std::reverse(begin(v), end(v));
+        ASSERT_EQUALS(std::get<0>(args), v);
+    }
+
+    PROPERTY_TEST(unsigned_addition_commutes, unsigned, unsigned)
+    {
+        ASSERT_EQUALS(std::get<0>(args) + std::get<1>(args), std::get<1>(args) + std::get<0>(args));
+    }
+
+    PROPERTY_TEST(strings_concatenate, std::string, std::string)
+    {
+        auto joined = std::get<0>(args) + std::get<1>(args);
+        ASSERT_EQUALS(std::get<0>(args).size() + std::get<1>(args).size(), joined.size());
+    }
+
+    struct below_100
+    {
+        using args_type = std::tuple<int, std::string>;
+        void operator()(const args_type& args) const
+        {
+            ASSERT_TRUE(std::get<0>(args) < 100);
+        }
+    };
+
+    struct expects_below_100
+    {
+        using args_type = std::tuple<int, std::string>;
+        void operator()(const args_type& args) const
+        {
+            EXPECT_TRUE("below 100", std::get<0>(args) < 100);
+            EXPECT_TRUE("below 200", std::get<0>(args) < 200);
+        }
+    };
+
+    template <class Property = below_100>
+    std::string run_failing_property(std::vector<std::string> args)
+    {
+        UnitTests::MiniSuite::Node node("properties", "below_100", __FILE__, __LINE__,
+            &UnitTests::PropertyTest<Property>::run, &UnitTests::PropertyTest<Property>::count, nullptr);
+        auto suite = UnitTests::MiniSuite{};
+        suite.AddTest(node);
+
+        auto os = std::ostringstream{};
+        args.insert(begin(args), "");
+        suite.RunTests(args, os);
+        auto report = os.str();
+        return report.substr(0, report.find("\nTime taken"));
+    }
+
+    TEST(failing_properties_are_shrunk_to_a_minimal_counterexample)
+    {
+        auto report = run_failing_property({"--seed", "42"});
+        ASSERT_IN("Property falsified by (100, ) (case "s, report);
+        ASSERT_IN("reproduce with --seed 42) : Expression evaluated to false"s, report);
+        ASSERT_IN("4 Tests."s, report);
+    }
+
+    TEST(failed_expects_falsify_a_property_like_assertions)
+    {
+        auto report = run_failing_property<expects_below_100>({"--seed", "42"});
+        ASSERT_IN("Property falsified by (100, ) (case "s, report);
+        ASSERT_IN("reproduce with --seed 42) :below 100 Expression evaluated to false"s, report);
+        ASSERT_NOT_IN("below 200"s, report);
+        ASSERT_IN("4 Tests."s, report);
+        ASSERT_TRUE(UnitTests::RecordedFailures().empty());
+    }
+
+    TEST(a_seed_reproduces_the_same_cases_on_any_number_of_threads)
+    {
+        auto once = run_failing_property({"--seed", "7", "--property-cases", "500"});
+        ASSERT_EQUALS(once, run_failing_property({"--seed", "7", "--property-cases", "500", "--jobs", "4"}));
+        ASSERT_IN("2 Tests."s, once);
+    }
+
+    TEST(property_cases_must_be_positive)
+    {
+        ASSERT_THROWS_WITH_MESSAGE(std::runtime_error, "at least 1", run_failing_property({"--property-cases", "0"}));
+    }
+
+    TEST(integers_shrink_towards_zero)
+    {
+        auto smaller = UnitTests::Arbitrary<int>::shrink(-10);
+        ASSERT_EQUALS(0, smaller.front());
+        ASSERT_EQUALS(10, smaller[1]);
+        ASSERT_EQUALS(-9, smaller.back());
+        ASSERT_TRUE(UnitTests::Arbitrary<int>::shrink(0).empty());
+    }
+} // namespace
@@ -0,0 +1,107 @@
+#include "testframework/MiniTestFramework.h"
+#include "testframework/resultslog.h"
+
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+using namespace std::literals;
+
+namespace
+{
+    const char* test_suite = "results_log_tests";
+
+#if defined(TESTFRAMEWORK_HAS_MMAP)
+    // each test has a log of its own, as the tests may run at the same time
+    void write_log(UnitTests::MiniSuite& suite, const std::string& log_name)
+    {
+        auto os = std::ostringstream{};
+        suite.RunTests({"", "--results-bin", log_name}, os);
+    }
+
+    TEST(each_test_has_a_record)
+    {
+        auto log_name = "results_log_tests_records.bin"s;
+        auto suite = UnitTests::MiniSuite{};
+        suite.AddTest([] {}, "first", "passes", __FILE__, __LINE__);
+        suite.AddTest([] { ASSERT_EQUALS(1, 2); }, "first", "fails", __FILE__, __LINE__);
+        suite.AddTest([] { SKIP(); }, "second", "skips", __FILE__, __LINE__);
+        write_log(suite, log_name);
+
+        {
+            const UnitTests::ResultsLog log(log_name);
+            ASSERT_EQUALS(3U, log.size());
+
+            auto records = std::vector<UnitTests::results_log::Record>(log.begin(), log.end());
+            ASSERT_EQUALS("first"s, log.string(records[0].suite));
+            ASSERT_EQUALS("passes"s, log.string(records[0].name));
+            ASSERT_EQUALS(uint32_t{UnitTests::results_log::Passed}, records[0].status);
+            ASSERT_EQUALS(UnitTests::results_log::no_string, records[0].message);
+
+            ASSERT_EQUALS(uint32_t{UnitTests::results_log::Failed}, records[1].status);
+            ASSERT_EQUALS(records[0].suite, records[1].suite);
+            ASSERT_EQUALS(UnitTests::results_log::SuiteHash("first"), records[1].suite_hash);
+            ASSERT_EQUALS(UnitTests::results_log::TestHash("first", "fails"), records[1].test_hash);
+            ASSERT_IN("but got <2>"s, log.string(records[1].message));
+
+            ASSERT_EQUALS("second"s, log.string(records[2].suite));
+            ASSERT_EQUALS(uint32_t{UnitTests::results_log::Skipped}, records[2].status);
+        }
+        std::remove(log_name.c_str());
+        ASSERT_FALSE(std::ifstream(log_name + ".heap").good());
+    }
+
+    TEST(the_log_grows_for_many_tests)
+    {
+        auto log_name = "results_log_tests_many.bin"s;
+        auto suite   = UnitTests::MiniSuite{};
+        auto numbers = std::vector<int>(5000);
+        suite.AddParamTest(numbers, [](int) {}, "many", "param", __FILE__, __LINE__);
+        write_log(suite, log_name);
+
+        {
+            const UnitTests::ResultsLog log(log_name);
+            ASSERT_EQUALS(numbers.size(), log.size());
+            ASSERT_EQUALS("many"s, log.string((log.end() - 1)->suite));
+        }
+        std::remove(log_name.c_str());
+    }
+
+    TEST(the_log_converts_to_junit_and_json)
+    {
+        auto log_name = "results_log_tests_converted.bin"s;
+        auto suite = UnitTests::MiniSuite{};
+        suite.AddTest([] {}, "first", "passes", __FILE__, __LINE__);
+        suite.AddTest([] { throw std::runtime_error("\"<bad>\""); }, "first", "throws", __FILE__, __LINE__);
+        write_log(suite, log_name);
+
+        auto xml  = std::ostringstream{};
+        auto json = std::ostringstream{};
+        {
+            const UnitTests::ResultsLog log(log_name);
+            UnitTests::WriteJUnit(log, xml);
+            UnitTests::WriteJson(log, json);
+        }
+        std::remove(log_name.c_str());
+
+        ASSERT_IN(
+            "<testsuite id=\"0\" name=\"first\" tests=\"2\" failures=\"0\" errors=\"1\" skipped=\"0\" time=\""s,
+            xml.str());
+        ASSERT_IN("&quot;&lt;bad&gt;&quot;"s, xml.str());
+        ASSERT_IN("{\"suite\": \"first\", \"name\": \"passes\", \"status\": \"passed\", \"wall_ns\": "s, json.str());
+        ASSERT_IN("\"status\": \"error\""s, json.str());
+        ASSERT_IN("\\\"<bad>\\\""s, json.str());
+    }
+#endif
+
+    TEST(a_file_that_is_not_a_log_is_refused)
+    {
+        auto name = "results_log_tests.txt"s;
+        std::ofstream(name) << "This is not a results log, but it is long enough to hold a header.";
+        ASSERT_THROWS_WITH_MESSAGE(std::runtime_error, "is not a results log", UnitTests::ResultsLog{name});
+        std::remove(name.c_str());
+        ASSERT_THROWS(std::runtime_error, UnitTests::ResultsLog{name});
+    }
+} // namespace
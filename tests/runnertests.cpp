@@ -0,0 +1,577 @@
+#include "testframework/MiniTestFramework.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <forward_list>
+#include <fstream>
+#include <iterator>
+#include <list>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace std::literals;
+
+namespace
+{
+    const char* test_suite = "runner_tests";
+
+    // runs `suite` with the given command line, returning the report without the timing line at the end
+    std::string run(UnitTests::MiniSuite& suite, std::vector<std::string> args)
+    {
+        auto os = std::ostringstream{};
+        args.insert(begin(args), "");
+        suite.RunTests(args, os);
+        auto report = os.str();
+        return report.substr(0, report.find("\nTime taken"));
+    }
+
+    // the verbose report without the time each test took, which is different every run
+    std::string without_times(std::string report)
+    {
+        for (auto cpu = report.find("ms, cpu "); cpu != std::string::npos; cpu = report.find("ms, cpu ", cpu))
+        {
+            auto first = report.rfind(" (", cpu);
+            auto last  = report.find("ms)", cpu + 1) + 3;
+            report.erase(first, last - first);
+            cpu = first;
+        }
+        return report;
+    }
+
+    // the number after `label` in `text`
+    double number_after(const std::string& text, const std::string& label, size_t from = 0)
+    {
+        auto at = text.find(label, from);
+        ASSERT_TRUE("Expected to find " + label, at != std::string::npos);
+        return std::stod(text.substr(at + label.size()));
+    }
+
+    const int numbers[] = {0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15};
+
+    void add_tests(UnitTests::MiniSuite& suite, std::atomic<int>& count)
+    {
+        suite.AddTest([&count] { ++count; }, "first", "pass", __FILE__, __LINE__);
+        suite.AddTest([] { FAIL("failed"); }, "first", "fail", __FILE__, __LINE__);
+        suite.AddParamTest(numbers,
+            [&count](int n) {
+                ++count;
+                ASSERT_TRUE(n % 5 != 0);
+            },
+            "second", "param", __FILE__, __LINE__);
+        suite.AddTest([] { throw std::runtime_error("error"); }, "second", "error", __FILE__, __LINE__);
+    }
+
+    TEST(jobs_report_matches_sequential_run)
+    {
+        std::atomic<int> count{0};
+        auto             sequential = UnitTests::MiniSuite{};
+        auto             parallel   = UnitTests::MiniSuite{};
+        add_tests(sequential, count);
+        add_tests(parallel, count);
+
+        auto expected = without_times(run(sequential, {"-v"}));
+        ASSERT_EQUALS(expected, without_times(run(parallel, {"-v", "--jobs", "4"})));
+        ASSERT_EQUALS(34, count.load());
+        ASSERT_IN("19 Tests.\n0 Skipped.\n5 Failures.\n1 Errors."s, expected);
+    }
+
+    void count_node(const UnitTests::MiniSuite::Node& node, int index)
+    {
+        auto& counts = *static_cast<std::vector<int>*>(const_cast<void*>(node.Data()));
+        counts.push_back(index);
+    }
+
+    int three_indexes(const UnitTests::MiniSuite::Node& /*unused*/)
+    {
+        return 3;
+    }
+
+    TEST(static_nodes_run_in_registration_order)
+    {
+        auto                       runs = std::vector<int>{};
+        UnitTests::MiniSuite::Node first("nodes", "first", __FILE__, __LINE__, [] {});
+        UnitTests::MiniSuite::Node second("nodes", "second", __FILE__, __LINE__, count_node, three_indexes, &runs);
+        auto                       suite = UnitTests::MiniSuite{};
+        suite.AddTest(first);
+        suite.AddTest([] {}, "nodes", "third", __FILE__, __LINE__);
+        suite.AddTest(second);
+
+        auto report = run(suite, {"-v"});
+        ASSERT_IN("Running first @"s, report);
+        ASSERT_TRUE(report.find("third @") < report.find("second[0] @"));
+        ASSERT_IN("5 Tests."s, report);
+        ASSERT_EQUALS(3u, runs.size());
+    }
+
+    TEST(param_tests_copy_arrays_and_containers)
+    {
+        int  table[] = {1, 2, 3};
+        auto seen    = std::vector<std::string>{};
+        auto suite   = UnitTests::MiniSuite{};
+        suite.AddParamTest(table, [&seen](int n) { seen.push_back(std::to_string(n)); }, "params", "array", __FILE__,
+            __LINE__);
+        {
+            auto list = std::list<std::string>{"a", "b"};
+            suite.AddParamTest(list, [&seen](const std::string& s) { seen.push_back(s); }, "params", "list", __FILE__,
+                __LINE__);
+        }
+        suite.AddParamTest(std::vector<int>{7}, [&seen](int n) { seen.push_back(std::to_string(n)); }, "params",
+            "temporary", __FILE__, __LINE__);
+
+        // the tests keep what they were given, though the array changed and the list is gone
+        table[1] = 5;
+        run(suite, {});
+        ASSERT_EQUALS((std::vector<std::string>{"1", "2", "3", "a", "b", "7"}), seen);
+    }
+
+    TEST(param_tests_use_a_param_view_in_place)
+    {
+        static int table[] = {1, 2, 3};
+        auto       seen    = std::vector<int>{};
+        auto       suite   = UnitTests::MiniSuite{};
+        suite.AddParamTest(UnitTests::MakeParamView(table), [&seen](int n) { seen.push_back(n); }, "params", "view",
+            __FILE__, __LINE__);
+
+        // the test sees a change made after it was added, so nothing was copied
+        table[1] = 5;
+        run(suite, {});
+        ASSERT_EQUALS((std::vector<int>{1, 5, 3}), seen);
+    }
+
+    TEST(jobs_must_be_a_number)
+    {
+        auto suite = UnitTests::MiniSuite{};
+        ASSERT_THROWS(std::invalid_argument, run(suite, {"--jobs", "many"}));
+        ASSERT_THROWS_WITH_MESSAGE(std::runtime_error, "a number of jobs", run(suite, {"--jobs"}));
+    }
+
+    TEST(shards_are_balanced_by_recorded_duration)
+    {
+        auto suite = UnitTests::MiniSuite{};
+        suite.AddTest([] { std::this_thread::sleep_for(50ms); }, "sharded", "slow", __FILE__, __LINE__);
+        for (auto name : {"a", "b", "c", "d"})
+        {
+            suite.AddTest([] {}, "sharded", name, __FILE__, __LINE__);
+        }
+
+        // the first run records the durations, after that the slow test gets a shard to itself
+        auto timings = "runner_tests_shards.timings"s;
+        run(suite, {"--timings", timings});
+        auto file     = std::ifstream(timings, std::ios::binary);
+        auto recorded = std::string(std::istreambuf_iterator<char>(file), {});
+        file.close();
+        auto shard    = [&](const char* index) {
+            std::ofstream(timings, std::ios::binary) << recorded;
+            return run(suite, {"-v", "--timings", timings, "--shard-count", "2", "--shard-index", index});
+        };
+
+        auto first  = shard("0");
+        auto second = shard("1");
+        std::remove(timings.c_str());
+
+        ASSERT_IN("Running slow @"s, first);
+        ASSERT_IN("1 Tests."s, first);
+        ASSERT_IN("4 Tests."s, second);
+    }
+
+    // the names of the tests a verbose report ran
+    std::vector<std::string> tests_run(const std::string& report)
+    {
+        auto names = std::vector<std::string>{};
+        for (auto at = report.find("Running "); at != std::string::npos; at = report.find("Running ", at))
+        {
+            at += 8;
+            names.push_back(report.substr(at, report.find(" @", at) - at));
+        }
+        return names;
+    }
+
+    TEST(shards_with_their_own_timings_file_agree_on_the_split)
+    {
+        auto suite = UnitTests::MiniSuite{};
+        suite.AddParamTest(
+            numbers, [](int n) { std::this_thread::sleep_for(std::chrono::milliseconds(n % 4)); }, "sharded", "param",
+            __FILE__, __LINE__);
+
+        // each shard starts with a copy of the same timings, as if it were on a machine of its own
+        auto timings = std::vector<std::string>{"runner_tests_shard0.timings", "runner_tests_shard1.timings"};
+        run(suite, {"--timings", timings[0]});
+        {
+            auto file = std::ifstream(timings[0], std::ios::binary);
+            std::ofstream(timings[1], std::ios::binary) << file.rdbuf();
+        }
+
+        for (auto pass = 0; pass != 3; ++pass)
+        {
+            auto names = std::vector<std::string>{};
+            for (auto index : {0, 1})
+            {
+                auto report = run(suite, {"-v", "--timings", timings[index], "--shard-count", "2", "--shard-index",
+                                             std::to_string(index)});
+                auto shard  = tests_run(report);
+                ASSERT_FALSE(shard.empty());
+                names.insert(end(names), begin(shard), end(shard));
+            }
+            std::sort(begin(names), end(names));
+            ASSERT_EQUALS(sizeof numbers / sizeof numbers[0], names.size());
+            ASSERT_TRUE(std::adjacent_find(begin(names), end(names)) == end(names));
+        }
+
+        // --timings-out collects the durations of a shard without changing what the shards split by
+        auto out = "runner_tests_shard_out.timings"s;
+        run(suite, {"--timings", timings[0], "--timings-out", out, "--shard-count", "2", "--shard-index", "1"});
+        ASSERT_TRUE(std::ifstream(out).good());
+        for (auto& filename : timings)
+            std::remove(filename.c_str());
+        std::remove(out.c_str());
+    }
+
+    TEST(a_corrupt_timings_file_is_ignored_and_replaced)
+    {
+        auto suite = UnitTests::MiniSuite{};
+        suite.AddTest([] {}, "timed", "first", __FILE__, __LINE__);
+        suite.AddTest([] {}, "timed", "second", __FILE__, __LINE__);
+
+        auto timings    = "runner_tests_corrupt.timings"s;
+        auto file_size  = [&] {
+            return std::streamoff(std::ifstream(timings, std::ios::binary | std::ios::ate).tellg());
+        };
+        auto valid_size = std::streamoff{16 + 2 * 16};
+
+        // the right magic number and version, but far more entries than the file holds
+        const unsigned char huge[] = {'T', 'F', 'T', 'M', 1, 0, 0, 0, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0x7f};
+        std::ofstream(timings, std::ios::binary).write(reinterpret_cast<const char*>(huge), sizeof huge);
+        ASSERT_IN("2 Tests.\n0 Skipped.\n0 Failures.\n0 Errors."s, run(suite, {"--timings", timings}));
+        ASSERT_EQUALS(valid_size, file_size());
+
+        // cut short in the middle of an entry
+        {
+            auto file     = std::ifstream(timings, std::ios::binary);
+            auto recorded = std::string(std::istreambuf_iterator<char>(file), {});
+            file.close();
+            std::ofstream(timings, std::ios::binary) << recorded.substr(0, recorded.size() - 4);
+        }
+        ASSERT_IN("2 Tests.\n0 Skipped.\n0 Failures.\n0 Errors."s, run(suite, {"--timings", timings}));
+        ASSERT_EQUALS(valid_size, file_size());
+        std::remove(timings.c_str());
+    }
+
+    TEST(slowest_tests_are_reported_with_the_change_since_the_last_run)
+    {
+        auto suite = UnitTests::MiniSuite{};
+        suite.AddTest([] { std::this_thread::sleep_for(30ms); }, "timed", "slow", __FILE__, __LINE__);
+        suite.AddTest([] {}, "timed", "fast", __FILE__, __LINE__);
+        suite.AddTest([] {}, "untimed", "other", __FILE__, __LINE__);
+
+        auto timings = "runner_tests_slowest.timings"s;
+        std::remove(timings.c_str());
+        auto first  = run(suite, {"--timings", timings, "--report-slowest", "1"});
+        auto second = run(suite, {"--timings", timings, "--report-slowest", "5"});
+        std::remove(timings.c_str());
+
+        ASSERT_IN("Slowest 1 Tests :-\n"s, first);
+        ASSERT_IN("ms  timed.slow (new)\nTime by suite :-\n"s, first);
+        ASSERT_NOT_IN("timed.fast"s, first);
+        ASSERT_IN("Slowest 3 Tests :-\n"s, second);
+        ASSERT_IN("ms  timed.slow ("s, second);
+        ASSERT_IN("% from "s, second);
+        ASSERT_IN("ms  timed\n"s, second);
+        ASSERT_IN("ms  untimed\n3 Tests."s, second);
+        ASSERT_NOT_IN("Slowest"s, run(suite, {}));
+        ASSERT_THROWS_WITH_MESSAGE(std::runtime_error, "at least 1", run(suite, {"--report-slowest", "0"}));
+    }
+
+    TEST(shard_index_must_be_less_than_count)
+    {
+        auto suite = UnitTests::MiniSuite{};
+        ASSERT_THROWS_WITH_MESSAGE(
+            std::runtime_error, "less than the shard count", run(suite, {"--shard-count", "2", "--shard-index", "2"}));
+    }
+
+    TEST(filter_selects_tests_by_suite_and_name)
+    {
+        auto suite = UnitTests::MiniSuite{};
+        suite.AddTest([] {}, "parser", "empty", __FILE__, __LINE__);
+        suite.AddTest([] {}, "parser", "nested", __FILE__, __LINE__);
+        suite.AddParamTest(numbers, [](int) {}, "parser", "numbers", __FILE__, __LINE__);
+        suite.AddTest([] {}, "lexer", "empty", __FILE__, __LINE__);
+        suite.AddTest([] {}, "lexer", "keyword", __FILE__, __LINE__);
+
+        ASSERT_IN("20 Tests."s, run(suite, {"--filter", "*"}));
+        ASSERT_IN("18 Tests."s, run(suite, {"--filter", "parser.*"}));
+        ASSERT_IN("2 Tests."s, run(suite, {"--filter", "*.empty"}));
+        ASSERT_IN("3 Tests."s, run(suite, {"--filter", "parser.n?sted:lexer.*"}));
+        ASSERT_IN("17 Tests."s, run(suite, {"--filter", "-*.empty:lexer.keyword"}));
+        ASSERT_IN("16 Tests."s, run(suite, {"--filter", "parser.*-*.empty:*.nes*"}));
+        ASSERT_IN("0 Tests."s, run(suite, {"--filter", "parser"}));
+    }
+
+    // the hung test is still running once the run has finished, so this suite must outlive it
+    UnitTests::MiniSuite& timeout_tests()
+    {
+        static auto suite = [] {
+            auto tests = UnitTests::MiniSuite{};
+            tests.AddTest([] {}, "timeouts", "quick", __FILE__, __LINE__);
+            tests.AddTest([] { std::this_thread::sleep_for(2s); }, "timeouts", "hung", __FILE__, __LINE__);
+            tests.AddTest(
+                [] {
+                    TIMEOUT(20);
+                    std::this_thread::sleep_for(300ms);
+                },
+                "timeouts", "limited", __FILE__, __LINE__);
+            tests.AddTest([] {}, "timeouts", "after", __FILE__, __LINE__);
+            return tests;
+        }();
+        return suite;
+    }
+
+    void check_timeouts(UnitTests::MiniSuite& suite, std::vector<std::string> args)
+    {
+        args.insert(end(args), {"--timeout-ms", "100"});
+        auto start  = std::chrono::steady_clock::now();
+        auto report = run(suite, args);
+        ASSERT_TRUE("The hung tests should have been abandoned", std::chrono::steady_clock::now() - start < 1s);
+        ASSERT_IN(".FF.\n"s, report);
+        ASSERT_IN("error A1001: Test timeout : Test took longer than 100ms while testing TEST(hung"s, report);
+        ASSERT_IN("error A1001: Test timeout : Test took longer than 20ms while testing TEST(limited"s, report);
+    }
+
+    TEST(timeouts_abandon_hung_tests)
+    {
+        check_timeouts(timeout_tests(), {});
+        check_timeouts(timeout_tests(), {"--jobs", "2"});
+    }
+
+    TEST(a_hung_test_with_a_timeout_is_abandoned_without_timeout_ms)
+    {
+        // the suite must outlive the abandoned test
+        static auto suite = [] {
+            auto tests = UnitTests::MiniSuite{};
+            tests.AddTest(
+                [] {
+                    TIMEOUT(20);
+                    std::this_thread::sleep_for(2s);
+                },
+                "timeouts", "hangs", __FILE__, __LINE__);
+            tests.AddTest([] {}, "timeouts", "after", __FILE__, __LINE__);
+            return tests;
+        }();
+
+        auto start  = std::chrono::steady_clock::now();
+        auto report = run(suite, {});
+        ASSERT_TRUE("The hung test should have been abandoned", std::chrono::steady_clock::now() - start < 1s);
+        ASSERT_IN("F.\n"s, report);
+        ASSERT_IN("Test took longer than 20ms while testing TEST(hangs"s, report);
+    }
+
+    TEST(wall_and_cpu_time_are_reported_for_each_test)
+    {
+        auto suite = UnitTests::MiniSuite{};
+        suite.AddTest([] { std::this_thread::sleep_for(20ms); }, "timed", "sleeps", __FILE__, __LINE__);
+
+        // sleeping takes time on the wall but hardly any CPU time
+        auto report = run(suite, {"-v"});
+        ASSERT_TRUE(number_after(report, "OK (") >= 20.0);
+        ASSERT_TRUE(number_after(report, "ms, cpu ") < 10.0);
+
+        auto filename = "runner_tests_times.xml"s;
+        run(suite, {"--xml", filename});
+        auto file = std::ifstream(filename);
+        auto xml  = std::string(std::istreambuf_iterator<char>(file), {});
+        file.close();
+        std::remove(filename.c_str());
+        ASSERT_TRUE(number_after(xml, "name=\"sleeps\" time=\"") >= 0.02);
+        ASSERT_TRUE(number_after(xml, "time=\"", xml.find("<testsuite ")) >= 0.02);
+    }
+
+    TEST(xml_has_the_totals_of_each_suite_and_escapes_text)
+    {
+        auto suite = UnitTests::MiniSuite{};
+        // the tests of a suite registered apart are still reported together
+        suite.AddTest([] {}, "first", "passes", __FILE__, __LINE__);
+        suite.AddTest([] { SKIP(); }, "second<'>", "skips", __FILE__, __LINE__);
+        suite.AddTest([] { ASSERT_EQUALS("<a & b>"s, "\"c\""s); }, "first", "fails", __FILE__, __LINE__);
+
+        auto filename = "runner_tests_escaped.xml"s;
+        run(suite, {"--xml", filename});
+        auto file = std::ifstream(filename);
+        auto xml  = std::string(std::istreambuf_iterator<char>(file), {});
+        file.close();
+        std::remove(filename.c_str());
+
+        ASSERT_IN("<testsuite id=\"0\" name=\"first\" tests=\"2\" failures=\"1\" errors=\"0\" skipped=\"0\" time=\""s,
+            xml);
+        ASSERT_IN("<testsuite id=\"1\" name=\"second&lt;&apos;&gt;\" tests=\"1\" failures=\"0\" errors=\"0\" "
+                  "skipped=\"1\" time=\""s,
+            xml);
+        ASSERT_IN("&lt;a &amp; b&gt;"s, xml);
+        ASSERT_IN("&quot;c&quot;"s, xml);
+        ASSERT_NOT_IN("<a & b>"s, xml);
+        ASSERT_IN("  </testsuite>\n</testsuites>\n"s, xml);
+        ASSERT_NOT_IN("<testsuite id=\"2\""s, xml);
+    }
+
+    TEST(json_lines_have_an_event_for_each_step_of_the_run)
+    {
+        auto suite = UnitTests::MiniSuite{};
+        suite.AddTest([] {}, "events", "passes", __FILE__, __LINE__);
+        suite.AddTest([] { throw std::runtime_error("a \"quoted\"\nline"); }, "events", "throws", __FILE__, __LINE__);
+
+        for (auto jobs : {"1", "2"})
+        {
+            auto lines = run(suite, {"--jsonl", "-", "--jobs", jobs});
+            ASSERT_IN("{\"event\": \"run_start\", \"tests\": 2}\n"
+                      "{\"event\": \"test_start\", \"suite\": \"events\", \"name\": \"passes\"}\n"
+                      "{\"event\": \"test_end\", \"suite\": \"events\", \"name\": \"passes\", \"status\": \"passed\", "
+                      "\"wall_ns\": "s,
+                lines);
+            ASSERT_IN("{\"event\": \"test_start\", \"suite\": \"events\", \"name\": \"throws\"}\n"
+                      "{\"event\": \"test_end\", \"suite\": \"events\", \"name\": \"throws\", \"status\": \"error\", "s,
+                lines);
+            ASSERT_IN("a \\\"quoted\\\"\\nline"s, lines);
+
+            // the run_end is the last line, with nothing else written after it
+            auto run_end = "{\"event\": \"run_end\", \"tests\": 2, \"skipped\": 0, \"failures\": 0, \"errors\": 1}\n"s;
+            ASSERT_EQUALS(lines.size() - run_end.size(), lines.rfind(run_end));
+        }
+    }
+
+    TEST(several_reporters_see_every_test)
+    {
+        auto suite   = UnitTests::MiniSuite{};
+        auto numbers = std::vector<int>(3000);
+        suite.AddParamTest(numbers, [](int) {}, "many", "param", __FILE__, __LINE__);
+        suite.AddTest([] { FAIL("failed"); }, "many", "fails", __FILE__, __LINE__);
+
+        auto filename = "runner_tests_several.xml"s;
+        auto jsonl    = "runner_tests_several.jsonl"s;
+        for (auto jobs : {"1", "4"})
+        {
+            auto report = run(suite, {"--xml", filename, "--jsonl", jsonl, "--jobs", jobs});
+            auto file   = std::ifstream(filename);
+            auto xml    = std::string(std::istreambuf_iterator<char>(file), {});
+            file.close();
+            auto lines = std::ifstream(jsonl);
+            auto json  = std::string(std::istreambuf_iterator<char>(lines), {});
+            lines.close();
+
+            ASSERT_IN("3001 Tests.\n0 Skipped.\n1 Failures.\n0 Errors."s, report);
+            ASSERT_IN("name=\"many\" tests=\"3001\" failures=\"1\""s, xml);
+            ASSERT_IN("\"name\": \"param[2999]\""s, json);
+            ASSERT_IN("{\"event\": \"run_end\", \"tests\": 3001, \"skipped\": 0, \"failures\": 1, \"errors\": 0}\n"s,
+                json);
+        }
+        std::remove(filename.c_str());
+        std::remove(jsonl.c_str());
+    }
+
+    TEST(skipped_tests_are_reported_as_skipped)
+    {
+        auto suite = UnitTests::MiniSuite{};
+        suite.AddTest([] { SKIP(); }, "skipping", "skipped", __FILE__, __LINE__);
+        suite.AddTest([] {}, "skipping", "passed", __FILE__, __LINE__);
+        ASSERT_IN("S.\n"s, run(suite, {}));
+        ASSERT_IN("2 Tests.\n1 Skipped.\n0 Failures.\n0 Errors."s, run(suite, {"--jobs", "2"}));
+    }
+
+    TEST(expect_failures_are_reported_when_the_test_ends)
+    {
+        auto checked = std::make_shared<std::atomic<int>>(0);
+        auto suite   = UnitTests::MiniSuite{};
+        suite.AddTest(
+            [checked] {
+                EXPECT_EQUALS(1, 2);
+                EXPECT_TRUE("first", false);
+                EXPECT_IN("needle"s, "haystack"s);
+                EXPECT_FALSE(false);
+                ++*checked;
+            },
+            "expecting", "fails", __FILE__, __LINE__);
+        suite.AddTest([] { EXPECT_EQUALS(1, 1); }, "expecting", "passes", __FILE__, __LINE__);
+        suite.AddTest(
+            [] {
+                EXPECT_EQUALS("recorded"s, "then"s);
+                throw std::runtime_error("thrown");
+            },
+            "expecting", "throws", __FILE__, __LINE__);
+
+        for (auto jobs : {"1", "2"})
+        {
+            auto report = run(suite, {"--jobs", jobs});
+            ASSERT_IN("3 Tests.\n0 Skipped.\n1 Failures.\n1 Errors."s, report);
+            ASSERT_IN("but got <2>"s, report);
+            ASSERT_IN("first Expression evaluated to false"s, report);
+            ASSERT_IN("Expected to find \"needle\""s, report);
+            ASSERT_IN("Expected <recorded>"s, report);
+            ASSERT_IN("thrown"s, report);
+        }
+        ASSERT_EQUALS(2, checked->load());
+        ASSERT_TRUE(UnitTests::RecordedFailures().empty());
+    }
+
+    // the counters are not available everywhere (e.g. in many containers and virtual machines), then the run goes on
+    void check_perf_counters(std::vector<std::string> args)
+    {
+        auto suite = UnitTests::MiniSuite{};
+        suite.AddTest([] {}, "counted", "pass", __FILE__, __LINE__);
+        suite.AddTest([] { FAIL("failed"); }, "counted", "fail", __FILE__, __LINE__);
+
+        args.insert(end(args), {"-v", "--perf-counters"});
+        auto report = run(suite, args);
+        ASSERT_IN("2 Tests.\n0 Skipped.\n1 Failures."s, report);
+        if (report.find("Hardware performance counters are not available") == std::string::npos)
+        {
+            ASSERT_IN("OK cycles="s, without_times(report));
+            ASSERT_IN("FAIL cycles="s, without_times(report));
+            ASSERT_IN(" ipc="s, report);
+            ASSERT_IN(" branch-misses="s, report);
+        }
+        else
+        {
+            ASSERT_IN("Running pass @ "s, report);
+            ASSERT_NOT_IN("cycles="s, report);
+        }
+    }
+
+    TEST(perf_counters_are_reported_for_each_test)
+    {
+        check_perf_counters({});
+        check_perf_counters({"--jobs", "2"});
+#if !defined(_WIN32)
+        check_perf_counters({"--isolate"});
+#endif
+    }
+
+#if !defined(_WIN32)
+    TEST(isolate_reports_crashes_and_carries_on)
+    {
+        auto suite = UnitTests::MiniSuite{};
+        suite.AddTest([] {}, "isolated", "before", __FILE__, __LINE__);
+        suite.AddTest([] { std::abort(); }, "isolated", "crash", __FILE__, __LINE__);
+        suite.AddTest([] { FAIL("failed"); }, "isolated", "fail", __FILE__, __LINE__);
+        suite.AddTest([] { std::exit(3); }, "isolated", "exit", __FILE__, __LINE__);
+        suite.AddTest([] {}, "isolated", "after", __FILE__, __LINE__);
+
+        for (auto jobs : {"1", "3"})
+        {
+            auto report = run(suite, {"--isolate", "--jobs", jobs});
+            ASSERT_IN(".EFE.\n"s, report);
+            ASSERT_IN("Test crashed with signal "s, report);
+            ASSERT_IN("Test exited the process with status 3 while testing TEST(exit"s, report);
+            ASSERT_IN("5 Tests.\n0 Skipped.\n1 Failures.\n2 Errors."s, report);
+        }
+    }
+
+    TEST(isolated_timeouts_kill_the_worker)
+    {
+        check_timeouts(timeout_tests(), {"--isolate"});
+        check_timeouts(timeout_tests(), {"--isolate", "--jobs", "2"});
+    }
+#endif
+} // namespace
@@ -1,6 +1,10 @@
 #include "testframework/MiniTestFramework.h"
 #include "testframework/testfailure.h"
 
+#include <cstdio>
+#include <memory>
+#include <string>
+
 using namespace std::literals;
 
 TEST(msg)
@@ -26,3 +30,63 @@ TEST(timeout_msg1)
     auto f = UnitTests::TestTimeout("different", "filename", 120);
     ASSERT_EQUALS("filename(120) : error A1001: Test timeout : different"s, f.what());
 }
+
+TEST(what_is_formatted_once_and_kept)
+{
+    auto f     = UnitTests::TestLeak("message", "filename", 7);
+    auto first = f.what();
+    ASSERT_EQUALS("filename(7) : error A1004: Memory leak : message"s, first);
+    ASSERT_TRUE(first == f.what());
+    ASSERT_EQUALS("message"s, f.msg());
+}
+
+TEST(a_file_name_made_at_run_time_is_copied)
+{
+    auto file     = std::make_unique<std::string>("made/at/run/time.cpp");
+    auto named    = UnitTests::TestFailure("message", *file, 3);
+    auto pointed  = UnitTests::TestFailure("message", file->c_str(), 4, "Custom failure : "s, 1234);
+    auto timedout = UnitTests::TestTimeout("message", file->c_str(), 5);
+    file.reset();
+    ASSERT_EQUALS("made/at/run/time.cpp(3) : error A1000: Assertion failure : message"s, named.what());
+    ASSERT_EQUALS("made/at/run/time.cpp(4) : error A1234: Custom failure : message"s, pointed.what());
+    ASSERT_EQUALS("made/at/run/time.cpp(5) : error A1001: Test timeout : message"s, timedout.what());
+}
+
+TEST(a_file_name_in_a_buffer_or_temporary_is_copied)
+{
+    auto from_buffer = [] {
+        char buffer[32];
+        std::snprintf(buffer, sizeof buffer, "buffer%d.cpp", 7);
+        return UnitTests::TestFailure("boom", buffer, 7);
+    }();
+    ASSERT_EQUALS("buffer7.cpp(7) : error A1000: Assertion failure : boom"s, from_buffer.what());
+
+    auto message = std::string{};
+    try
+    {
+        UnitTests::Assert(std::string("made/at/") + "run_time.cpp", 9).Equals(1, 2);
+    }
+    catch (const UnitTests::TestFailure& e)
+    {
+        message = e.what();
+    }
+    ASSERT_IN("made/at/run_time.cpp(9) : error A1000: Assertion failure : "s, message);
+}
+
+void throw_and_catch(std::string message)
+{
+    try
+    {
+        FAIL(std::move(message));
+    }
+    catch (const UnitTests::TestFailure& e)
+    {
+        UnitTests::DoNotOptimize(e);
+    }
+}
+
+TEST(throwing_a_failure_allocates_nothing_but_its_message)
+{
+    auto message = std::string(200, 'x');
+    ASSERT_MAX_ALLOCATIONS(0, throw_and_catch(std::move(message)));
+}
@@ -0,0 +1,87 @@
+// testframework_results reads the results log a test executable writes with --results-bin FILE :
+//
+//   testframework_results FILE summary           the number of tests of each result and the time they took
+//   testframework_results FILE failures [SUITE]  the failures and errors, of just SUITE if it is given
+//   testframework_results FILE junit             the log as JUnit XML
+//   testframework_results FILE json              the log as JSON
+#include "testframework/resultslog.h"
+
+#include <cstdio>
+#include <exception>
+#include <iostream>
+#include <string>
+
+namespace
+{
+    int usage()
+    {
+        std::cerr << "Usage: testframework_results FILE summary | failures [SUITE] | junit | json\n";
+        return 2;
+    }
+
+    void summary(const UnitTests::ResultsLog& log)
+    {
+        uint64_t counts[] = {0, 0, 0, 0};
+        auto     time     = int64_t{0};
+        for (auto& record : log)
+        {
+            ++counts[record.status & 3];
+            time += record.wall_time;
+        }
+        std::cout << log.size() << " Tests.\n";
+        std::cout << counts[UnitTests::results_log::Skipped] << " Skipped.\n";
+        std::cout << counts[UnitTests::results_log::Failed] << " Failures.\n";
+        std::cout << counts[UnitTests::results_log::Error] << " Errors.\n";
+        std::cout << "Time taken by the tests = " << static_cast<double>(time) / 1e6 << "ms\n";
+    }
+
+    // the records are compared by the hash of their suite, so only the strings of those that match are read
+    int failures(const UnitTests::ResultsLog& log, const std::string* suite)
+    {
+        auto suite_hash = suite ? UnitTests::results_log::SuiteHash(*suite) : 0;
+        auto found      = 0;
+        for (auto& record : log)
+        {
+            if (record.status != UnitTests::results_log::Failed && record.status != UnitTests::results_log::Error)
+                continue;
+            if (suite && (record.suite_hash != suite_hash || log.string(record.suite) != *suite))
+                continue;
+
+            std::cout << "In suite: " << log.string(record.suite) << " " << log.string(record.message)
+                      << " while testing TEST(" << log.string(record.name) << ")\n";
+            ++found;
+        }
+        return found != 0 ? 1 : 0;
+    }
+} // namespace
+
+int main(int argc, char** argv)
+{
+    if (argc < 3)
+        return usage();
+
+    try
+    {
+        const UnitTests::ResultsLog log(argv[1]);
+        auto                        command = std::string(argv[2]);
+        if (command == "summary" && argc == 3)
+            summary(log);
+        else if (command == "failures" && argc <= 4)
+        {
+            auto suite = argc == 4 ? std::string(argv[3]) : std::string{};
+            return failures(log, argc == 4 ? &suite : nullptr);
+        }
+        else if (command == "junit" && argc == 3)
+            UnitTests::WriteJUnit(log, std::cout);
+        else if (command == "json" && argc == 3)
+            UnitTests::WriteJson(log, std::cout);
+        else
+            return usage();
+    }
+    catch (const std::exception& e)
+    {
+        std::cerr << e.what() << "\n";
+        return 2;
+    }
+    return 0;
+}